@@ -0,0 +1,510 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * bus-bench.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Runs items against a mock StatusNotifierWatcher (with a host always
+ * registered) on a private bus (requires dbus-daemon), and measures:
+ * - register: time from status_notifier_item_register() to the item being
+ *   registered, in us (mean over REG_ITEMS items)
+ * - reregister: time from the watcher coming back after a restart to the
+ *   items being registered again, in us
+ * - get: time per Get call from the host, in us
+ * - getall: time per GetAll call from the host, in us
+ * - signals: signals received by the host per second
+ * - method: time from the host calling Activate to getting the reply, in us,
+ *   with a handler taking HANDLER_DELAY us (mean over METHOD_CALLS calls)
+ * - wire: size in bytes of the reply message for a Get of IconPixmap or a
+ *   GetAll, for a given icon size
+ *
+ * The mock watcher and the host run in their own thread, the items in the main
+ * thread/context as in an application.
+ * Output is one line per measure:
+ *   <bench> <variant> [<size>] <value>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "statusnotifier.h"
+#include "interfaces.h"
+#include "mock-watcher.h"
+
+#define _UNUSED_        __attribute__ ((unused))
+
+#define REG_ITEMS       10
+#define CALLS           2000
+#define SIGNALS         5000
+#define METHOD_CALLS    200
+#define HANDLER_DELAY   2000
+
+static const gchar * const props[] = {
+    "Id", "Category", "Title", "Status", "WindowId", "IconName", "IconPixmap",
+    "OverlayIconName", "OverlayIconPixmap", "AttentionIconName",
+    "AttentionIconPixmap", "AttentionMovieName", "ToolTip", "ItemIsMenu", "Menu"
+};
+
+static const gint sizes[] = { 16, 22, 32, 48, 64, 128, 256 };
+
+/* host jobs run in their own thread (making sync calls to the items) while the
+ * main thread keeps serving them */
+
+typedef void (*HostJob) (gpointer data);
+
+typedef struct
+{
+    HostJob job;
+    gpointer data;
+    gint done;
+} HostRun;
+
+static gpointer
+host_thread (gpointer data)
+{
+    HostRun *run = data;
+
+    run->job (run->data);
+    g_atomic_int_set (&run->done, 1);
+    g_main_context_wakeup (NULL);
+    return NULL;
+}
+
+static void
+run_host (HostJob job, gpointer data)
+{
+    HostRun run = { job, data, 0 };
+    GThread *thread;
+
+    thread = g_thread_new ("host", host_thread, &run);
+    while (!g_atomic_int_get (&run.done))
+        g_main_context_iteration (NULL, TRUE);
+    g_thread_join (thread);
+}
+
+static GDBusMessage *
+host_call_full (const gchar *interface, const gchar *method, GVariant *params)
+{
+    GDBusMessage *msg, *reply;
+    GError *err = NULL;
+
+    g_mutex_lock (&mock.mutex);
+    msg = g_dbus_message_new_method_call (mock.item_name, mock.item_path,
+            interface, method);
+    g_mutex_unlock (&mock.mutex);
+    g_dbus_message_set_body (msg, params);
+
+    reply = g_dbus_connection_send_message_with_reply_sync (mock.conn, msg,
+            G_DBUS_SEND_MESSAGE_FLAGS_NONE, -1, NULL, NULL, &err);
+    g_object_unref (msg);
+    if (!reply)
+        g_error ("%s failed: %s", method, err->message);
+    if (g_dbus_message_to_gerror (reply, &err))
+        g_error ("%s failed: %s", method, err->message);
+    return reply;
+}
+
+static GDBusMessage *
+host_call (const gchar *method, GVariant *params)
+{
+    return host_call_full ("org.freedesktop.DBus.Properties", method, params);
+}
+
+static void
+job_get (gpointer data)
+{
+    const gchar *prop = data;
+    gint64 start;
+    guint i;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < CALLS; ++i)
+        g_object_unref (host_call ("Get",
+                    g_variant_new ("(ss)", ITEM_INTERFACE, prop)));
+    g_print ("get %s %.1f\n", prop,
+            (gdouble) (g_get_monotonic_time () - start) / CALLS);
+}
+
+static void
+job_get_all (gpointer data _UNUSED_)
+{
+    gint64 start;
+    guint i;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < CALLS; ++i)
+        g_object_unref (host_call ("GetAll",
+                    g_variant_new ("(s)", ITEM_INTERFACE)));
+    g_print ("getall default %.1f\n",
+            (gdouble) (g_get_monotonic_time () - start) / CALLS);
+}
+
+static void
+job_method (gpointer data)
+{
+    gint64 start, total = 0;
+    guint i;
+
+    for (i = 0; i < METHOD_CALLS; ++i)
+    {
+        start = g_get_monotonic_time ();
+        g_object_unref (host_call_full (ITEM_INTERFACE, "Activate",
+                    g_variant_new ("(ii)", 0, 0)));
+        total += g_get_monotonic_time () - start;
+        /* let the handler of a deferred signal be done */
+        g_usleep (2 * HANDLER_DELAY);
+    }
+    g_print ("method %s %.1f\n", (const gchar *) data,
+            (gdouble) total / METHOD_CALLS);
+}
+
+static gsize
+reply_size (GDBusMessage *reply)
+{
+    GError *err = NULL;
+    guchar *blob;
+    gsize size;
+
+    blob = g_dbus_message_to_blob (reply, &size, G_DBUS_CAPABILITY_FLAGS_NONE, &err);
+    if (!blob)
+        g_error ("Failed to serialize message: %s", err->message);
+    g_free (blob);
+    g_object_unref (reply);
+    return size;
+}
+
+static void
+job_wire (gpointer data)
+{
+    gint size = GPOINTER_TO_INT (data);
+
+    g_print ("wire IconPixmap %d %" G_GSIZE_FORMAT "\n", size,
+            reply_size (host_call ("Get",
+                    g_variant_new ("(ss)", ITEM_INTERFACE, "IconPixmap"))));
+    g_print ("wire GetAll %d %" G_GSIZE_FORMAT "\n", size,
+            reply_size (host_call ("GetAll",
+                    g_variant_new ("(s)", ITEM_INTERFACE))));
+}
+
+/* icons that can't be decoded must be sent as empty */
+static void
+job_broken (gpointer data)
+{
+    g_object_unref (host_call ("Get",
+                g_variant_new ("(ss)", ITEM_INTERFACE, "ToolTip")));
+    g_object_unref (host_call ("GetAll",
+                g_variant_new ("(s)", ITEM_INTERFACE)));
+    g_print ("broken %s ok\n", (const gchar *) data);
+}
+
+static GdkPixbuf *
+random_pixbuf (gint size)
+{
+    GdkPixbuf *pixbuf;
+    guint8 *pixels;
+    guint len, i;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+    pixels = gdk_pixbuf_get_pixels_with_length (pixbuf, &len);
+    for (i = 0; i < len; ++i)
+        pixels[i] = (guint8) g_random_int ();
+    return pixbuf;
+}
+
+static StatusNotifierItem *
+new_item (guint n, gboolean fast_start, StatusNotifierManager *manager)
+{
+    StatusNotifierItem *sn;
+    GdkPixbuf *pixbuf;
+    gchar *id;
+
+    id = g_strdup_printf ("bench-%u", n);
+    sn = (StatusNotifierItem *) g_object_new (STATUS_NOTIFIER_TYPE_ITEM,
+            "id",                       id,
+            "manager",                  manager,
+            "fast-start",               fast_start,
+            "title",                    "Benchmark item",
+            "status",                   STATUS_NOTIFIER_STATUS_ACTIVE,
+            "attention-icon-name",      "dialog-warning",
+            "tooltip-title",            "Benchmark",
+            "tooltip-body",             "Measuring <b>things</b>",
+            NULL);
+    g_free (id);
+
+    pixbuf = random_pixbuf (48);
+    status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_ICON, pixbuf);
+    status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_TOOLTIP_ICON, pixbuf);
+    g_object_unref (pixbuf);
+    return sn;
+}
+
+static void
+wait_registered (StatusNotifierItem **items, guint nb)
+{
+    guint i;
+
+    for (i = 0; i < nb; ++i)
+        for (;;)
+        {
+            StatusNotifierState state = status_notifier_item_get_state (items[i]);
+
+            if (state == STATUS_NOTIFIER_STATE_REGISTERED)
+                break;
+            if (state == STATUS_NOTIFIER_STATE_FAILED)
+                g_error ("Registration failed");
+            g_main_context_iteration (NULL, TRUE);
+        }
+}
+
+/* registers REG_ITEMS items, one at a time; returns the last one */
+static StatusNotifierItem *
+bench_register (const gchar             *variant,
+                GPtrArray               *all,
+                gboolean                 fast_start,
+                StatusNotifierManager   *manager)
+{
+    StatusNotifierItem *items[REG_ITEMS];
+    StatusNotifierRegistrationTimings timings;
+    gint64 total = 0;
+    guint i;
+
+    for (i = 0; i < REG_ITEMS; ++i)
+    {
+        items[i] = new_item (all->len, fast_start, manager);
+        g_ptr_array_add (all, items[i]);
+
+        status_notifier_item_register (items[i]);
+        wait_registered (&items[i], 1);
+        status_notifier_item_get_registration_timings (items[i], &timings);
+        total += timings.registered - timings.register_called;
+    }
+    g_print ("register %s %.0f\n", variant, (gdouble) total / REG_ITEMS);
+    return items[REG_ITEMS - 1];
+}
+
+/* registers REG_ITEMS items with the watcher only showing up afterwards, as at
+ * session start; measures from when it appeared */
+static void
+bench_register_late (const gchar *variant, GPtrArray *all, gboolean fast_start)
+{
+    StatusNotifierItem *items[REG_ITEMS];
+    StatusNotifierRegistrationTimings timings;
+    gint64 start, total = 0;
+    guint i;
+
+    mock_request_name (FALSE);
+    for (i = 0; i < REG_ITEMS; ++i)
+    {
+        items[i] = new_item (all->len, fast_start, NULL);
+        g_ptr_array_add (all, items[i]);
+        status_notifier_item_register (items[i]);
+    }
+    /* let them get as far as they can without a watcher */
+    start = g_get_monotonic_time ();
+    while (g_get_monotonic_time () - start < 100 * 1000)
+        if (!g_main_context_iteration (NULL, FALSE))
+            g_usleep (1000);
+    mock_request_name (TRUE);
+    wait_registered (items, REG_ITEMS);
+
+    for (i = 0; i < REG_ITEMS; ++i)
+    {
+        status_notifier_item_get_registration_timings (items[i], &timings);
+        total += timings.registered - timings.watcher_appeared;
+    }
+    g_print ("register late-%s %.0f\n", variant, (gdouble) total / REG_ITEMS);
+    /* (earlier items registered again as well) */
+    wait_registered ((StatusNotifierItem **) all->pdata, all->len);
+}
+
+static void
+bench_reregister (GPtrArray *all)
+{
+    StatusNotifierRegistrationTimings timings;
+    gint64 total = 0, max = 0;
+    guint i;
+
+    mock_request_name (FALSE);
+    /* wait for all items to have noticed */
+    for (i = 0; i < all->len; ++i)
+        while (status_notifier_item_get_state (all->pdata[i])
+                == STATUS_NOTIFIER_STATE_REGISTERED)
+            g_main_context_iteration (NULL, TRUE);
+    mock_request_name (TRUE);
+    wait_registered ((StatusNotifierItem **) all->pdata, all->len);
+
+    for (i = 0; i < all->len; ++i)
+    {
+        gint64 t;
+
+        status_notifier_item_get_registration_timings (all->pdata[i], &timings);
+        t = timings.registered - timings.watcher_appeared;
+        total += t;
+        max = MAX (max, t);
+    }
+    g_print ("reregister mean %.0f\n", (gdouble) total / all->len);
+    g_print ("reregister max %" G_GINT64_FORMAT "\n", max);
+}
+
+static void
+new_title (GDBusConnection *conn _UNUSED_,
+           const gchar     *sender _UNUSED_,
+           const gchar     *object _UNUSED_,
+           const gchar     *interface _UNUSED_,
+           const gchar     *signal _UNUSED_,
+           GVariant        *params _UNUSED_,
+           gpointer         data)
+{
+    ++*(guint *) data;
+}
+
+static void
+bench_signals (StatusNotifierItem *sn)
+{
+    gchar title[32];
+    guint received = 0;
+    gint64 start;
+    guint id, i;
+
+    /* subscribed from here, so received in the main context */
+    g_mutex_lock (&mock.mutex);
+    id = g_dbus_connection_signal_subscribe (mock.conn, NULL, ITEM_INTERFACE,
+            "NewTitle", mock.item_path, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+            new_title, &received, NULL);
+    g_mutex_unlock (&mock.mutex);
+
+    status_notifier_item_set_coalesce_signals (sn, FALSE);
+    start = g_get_monotonic_time ();
+    for (i = 0; i < SIGNALS; ++i)
+    {
+        g_snprintf (title, sizeof (title), "title %u", i);
+        status_notifier_item_set_title (sn, title);
+    }
+    while (received < SIGNALS)
+        g_main_context_iteration (NULL, TRUE);
+    g_print ("signals immediate %.0f\n",
+            (gdouble) SIGNALS * G_USEC_PER_SEC / (g_get_monotonic_time () - start));
+    status_notifier_item_set_coalesce_signals (sn, TRUE);
+
+    g_dbus_connection_signal_unsubscribe (mock.conn, id);
+}
+
+static gboolean
+slow_activate (StatusNotifierItem *sn _UNUSED_,
+               gint                x _UNUSED_,
+               gint                y _UNUSED_,
+               gpointer            data _UNUSED_)
+{
+    g_usleep (HANDLER_DELAY);
+    return TRUE;
+}
+
+static void
+bench_method (StatusNotifierItem *sn)
+{
+    gulong id;
+
+    id = g_signal_connect (sn, "activate", (GCallback) slow_activate, NULL);
+    run_host (job_method, "default");
+    status_notifier_item_set_reply_first (sn, TRUE);
+    run_host (job_method, "reply-first");
+    status_notifier_item_set_reply_first (sn, FALSE);
+    g_signal_handler_disconnect (sn, id);
+}
+
+int
+main (int argc, char *argv[])
+{
+    StatusNotifierManager *manager;
+    StatusNotifierItem *sn;
+    GTestDBus *bus;
+    GPtrArray *all;
+    GBytes *bytes;
+    GFile *file;
+    GIcon *gicon;
+    guint i;
+
+    (void) argc;
+    (void) argv;
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+    mock_start ();
+
+    all = g_ptr_array_new_with_free_func (g_object_unref);
+    manager = g_object_new (STATUS_NOTIFIER_TYPE_MANAGER,
+            "export-subtree", TRUE,
+            NULL);
+
+    bench_register ("default", all, FALSE, NULL);
+    bench_register ("fast-start", all, TRUE, NULL);
+    sn = bench_register ("subtree", all, FALSE, manager);
+    bench_reregister (all);
+    bench_register_late ("default", all, FALSE);
+    bench_register_late ("fast-start", all, TRUE);
+
+    /* only keep one item, and have it register again so it's the one the host
+     * talks to */
+    g_object_ref (sn);
+    g_ptr_array_set_size (all, 0);
+    mock_request_name (FALSE);
+    while (status_notifier_item_get_state (sn) == STATUS_NOTIFIER_STATE_REGISTERED)
+        g_main_context_iteration (NULL, TRUE);
+    mock_request_name (TRUE);
+    wait_registered (&sn, 1);
+
+    for (i = 0; i < G_N_ELEMENTS (props); ++i)
+        run_host (job_get, (gpointer) props[i]);
+    run_host (job_get_all, NULL);
+
+    bench_signals (sn);
+    bench_method (sn);
+
+    for (i = 0; i < G_N_ELEMENTS (sizes); ++i)
+    {
+        GdkPixbuf *pixbuf = random_pixbuf (sizes[i]);
+
+        status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_ICON, pixbuf);
+        g_object_unref (pixbuf);
+        run_host (job_wire, GINT_TO_POINTER (sizes[i]));
+    }
+
+    bytes = g_bytes_new_static ("not an image", 12);
+    status_notifier_item_set_from_bytes (sn, STATUS_NOTIFIER_TOOLTIP_ICON, bytes);
+    g_bytes_unref (bytes);
+    run_host (job_broken, "bytes");
+
+    file = g_file_new_for_path ("/nonexistent/bench-icon.svg");
+    gicon = g_file_icon_new (file);
+    g_object_unref (file);
+    status_notifier_item_set_from_gicon (sn, STATUS_NOTIFIER_TOOLTIP_ICON, gicon);
+    g_object_unref (gicon);
+    run_host (job_broken, "gicon");
+
+    g_object_unref (sn);
+    g_object_unref (manager);
+    g_ptr_array_unref (all);
+    mock_stop ();
+    g_test_dbus_down (bus);
+    g_object_unref (bus);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * menu-bench.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Compares the two ways of updating a large context menu: building a new
+ * GtkMenu and setting it (parsed whole, hosts fetch the whole layout again),
+ * and changing the menu already set in place (only what changed is updated).
+ * Needs a display for GTK, and a private bus (requires dbus-daemon) for the
+ * menus to be exported on.
+ * Output is one line per measure:
+ *   <bench> <variant> <entries> <us per update>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <gtk/gtk.h>
+#include "statusnotifier.h"
+
+#define ROUNDS          20
+
+static const guint entries[] = { 30, 300, 3000 };
+
+static GtkWidget *
+new_menu (guint nb, guint round)
+{
+    GtkWidget *menu;
+    guint i;
+
+    menu = gtk_menu_new ();
+    for (i = 0; i < nb; ++i)
+    {
+        GtkWidget *item;
+        gchar label[64];
+
+        g_snprintf (label, sizeof (label), "Recent item %u (%u)", i, round);
+        item = gtk_menu_item_new_with_label (label);
+        gtk_widget_show (item);
+        gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
+    }
+    return menu;
+}
+
+static void
+relabel (GtkWidget *widget, gpointer data)
+{
+    guint *i = data;
+    gchar label[64];
+
+    g_snprintf (label, sizeof (label), "Recent item %u (%u)", i[0]++, i[1]);
+    gtk_menu_item_set_label (GTK_MENU_ITEM (widget), label);
+}
+
+static void
+flush (void)
+{
+    while (g_main_context_pending (NULL))
+        g_main_context_iteration (NULL, FALSE);
+}
+
+int
+main (int argc, char *argv[])
+{
+    StatusNotifierItem *sn;
+    GTestDBus *bus;
+    guint e;
+
+    if (!gtk_init_check (&argc, &argv))
+    {
+        g_printerr ("menu-bench: no display, skipping\n");
+        return 77;
+    }
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+
+    sn = (StatusNotifierItem *) g_object_new (STATUS_NOTIFIER_TYPE_ITEM,
+            "id",             "menu-bench",
+            "main-icon-name", "applications-other",
+            NULL);
+
+    for (e = 0; e < G_N_ELEMENTS (entries); ++e)
+    {
+        GtkWidget *menu;
+        gint64 start;
+        guint round;
+
+        start = g_get_monotonic_time ();
+        for (round = 0; round < ROUNDS; ++round)
+        {
+            status_notifier_item_set_context_menu (sn,
+                    (GObject *) new_menu (entries[e], round));
+            flush ();
+        }
+        g_print ("menu new %u %.0f\n", entries[e],
+                (gdouble) (g_get_monotonic_time () - start) / ROUNDS);
+
+        menu = (GtkWidget *) status_notifier_item_get_context_menu (sn);
+        start = g_get_monotonic_time ();
+        for (round = 0; round < ROUNDS; ++round)
+        {
+            guint i[2] = { 0, round };
+
+            gtk_container_foreach (GTK_CONTAINER (menu), relabel, i);
+            status_notifier_item_set_context_menu (sn, (GObject *) menu);
+            flush ();
+        }
+        g_print ("menu in-place %u %.0f\n", entries[e],
+                (gdouble) (g_get_monotonic_time () - start) / ROUNDS);
+    }
+
+    g_object_unref (sn);
+    g_test_dbus_down (bus);
+    g_object_unref (bus);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * mock-watcher.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#include "config.h"
+
+#include "mock-watcher.h"
+#include "interfaces.h"
+
+#define _UNUSED_        __attribute__ ((unused))
+
+Mock mock;
+
+static void
+mock_method_call (GDBusConnection        *conn,
+                  const gchar            *sender,
+                  const gchar            *object _UNUSED_,
+                  const gchar            *interface _UNUSED_,
+                  const gchar            *method,
+                  GVariant               *params,
+                  GDBusMethodInvocation  *invocation,
+                  gpointer                data _UNUSED_)
+{
+    const gchar *service;
+
+    if (g_strcmp0 (method, "RegisterStatusNotifierItem") != 0)
+    {
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s", method);
+        return;
+    }
+
+    /* same as KDE's watcher: either a name or a path (with sender's name) */
+    g_variant_get (params, "(&s)", &service);
+    g_mutex_lock (&mock.mutex);
+    g_free (mock.item_name);
+    g_free (mock.item_path);
+    if (*service == '/')
+    {
+        mock.item_name = g_strdup (sender);
+        mock.item_path = g_strdup (service);
+    }
+    else
+    {
+        mock.item_name = g_strdup (service);
+        mock.item_path = g_strdup (ITEM_OBJECT);
+    }
+    g_mutex_unlock (&mock.mutex);
+
+    g_dbus_connection_emit_signal (conn, NULL, WATCHER_OBJECT, WATCHER_INTERFACE,
+            "StatusNotifierItemRegistered", g_variant_new ("(s)", service), NULL);
+    g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static GVariant *
+mock_get_property (GDBusConnection        *conn _UNUSED_,
+                   const gchar            *sender _UNUSED_,
+                   const gchar            *object _UNUSED_,
+                   const gchar            *interface _UNUSED_,
+                   const gchar            *property,
+                   GError                **error,
+                   gpointer                data _UNUSED_)
+{
+    if (g_strcmp0 (property, "IsStatusNotifierHostRegistered") == 0)
+        return g_variant_new_boolean (TRUE);
+
+    g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+            "Unknown property %s", property);
+    return NULL;
+}
+
+static const GDBusInterfaceVTable mock_vtable = {
+    .method_call = mock_method_call,
+    .get_property = mock_get_property,
+};
+
+void
+mock_request_name (gboolean own)
+{
+    GVariant *variant;
+    GError *err = NULL;
+
+    variant = g_dbus_connection_call_sync (mock.conn,
+            "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus",
+            (own) ? "RequestName" : "ReleaseName",
+            (own) ? g_variant_new ("(su)", WATCHER_NAME, 0)
+                : g_variant_new ("(s)", WATCHER_NAME),
+            NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, &err);
+    if (!variant)
+        g_error ("Failed to %s watcher name: %s",
+                (own) ? "request" : "release", err->message);
+    g_variant_unref (variant);
+}
+
+static gpointer
+mock_thread (gpointer data _UNUSED_)
+{
+    GDBusNodeInfo *node;
+    GError *err = NULL;
+
+    g_main_context_push_thread_default (mock.context);
+
+    mock.conn = g_dbus_connection_new_for_address_sync (
+            g_getenv ("DBUS_SESSION_BUS_ADDRESS"),
+            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+            | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+            NULL, NULL, &err);
+    if (!mock.conn)
+        g_error ("Failed to connect to private bus: %s", err->message);
+
+    node = g_dbus_node_info_new_for_xml (watcher_xml, NULL);
+    mock.reg_id = g_dbus_connection_register_object (mock.conn, WATCHER_OBJECT,
+            node->interfaces[0], &mock_vtable, NULL, NULL, &err);
+    g_dbus_node_info_unref (node);
+    if (mock.reg_id == 0)
+        g_error ("Failed to export watcher: %s", err->message);
+    mock_request_name (TRUE);
+
+    g_mutex_lock (&mock.mutex);
+    mock.ready = TRUE;
+    g_cond_signal (&mock.cond);
+    g_mutex_unlock (&mock.mutex);
+
+    g_main_loop_run (mock.loop);
+
+    g_dbus_connection_unregister_object (mock.conn, mock.reg_id);
+    g_main_context_pop_thread_default (mock.context);
+    return NULL;
+}
+
+void
+mock_start (void)
+{
+    g_mutex_init (&mock.mutex);
+    g_cond_init (&mock.cond);
+    mock.context = g_main_context_new ();
+    mock.loop = g_main_loop_new (mock.context, FALSE);
+    mock.thread = g_thread_new ("mock-watcher", mock_thread, NULL);
+
+    g_mutex_lock (&mock.mutex);
+    while (!mock.ready)
+        g_cond_wait (&mock.cond, &mock.mutex);
+    g_mutex_unlock (&mock.mutex);
+}
+
+void
+mock_stop (void)
+{
+    g_main_loop_quit (mock.loop);
+    g_thread_join (mock.thread);
+    g_main_loop_unref (mock.loop);
+    g_main_context_unref (mock.context);
+    g_object_unref (mock.conn);
+    g_free (mock.item_name);
+    g_free (mock.item_path);
+}
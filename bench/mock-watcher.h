@@ -0,0 +1,60 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * mock-watcher.h
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef __MOCK_WATCHER_H__
+#define __MOCK_WATCHER_H__
+
+/*
+ * A StatusNotifierWatcher (with a host always registered) running in its own
+ * thread, for benchmarks to register items against. Needs a session bus, e.g.
+ * from a GTestDBus.
+ */
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+    GThread *thread;
+    GMainContext *context;
+    GMainLoop *loop;
+    GDBusConnection *conn;
+    guint reg_id;
+
+    GMutex mutex;
+    GCond cond;
+    gboolean ready;
+    /* bus name & object path of the last registered item */
+    gchar *item_name;
+    gchar *item_path;
+} Mock;
+
+extern Mock mock;
+
+void        mock_start                  (void);
+void        mock_stop                   (void);
+void        mock_request_name           (gboolean own);
+
+G_END_DECLS
+
+#endif /* __MOCK_WATCHER_H__ */
@@ -0,0 +1,153 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * pixmap-bench.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Compares the pixbuf to pixmap conversion against the cairo round-trip that
+ * was used before. Output is one line per measure:
+ *   <bench> <variant> <size> <ns per icon>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <gdk/gdk.h>
+#include "pixmap.h"
+
+static const gint sizes[] = { 16, 22, 24, 32, 48, 64, 128, 256, 512 };
+
+static GdkPixbuf *
+random_pixbuf (gint size, gboolean has_alpha)
+{
+    GdkPixbuf *pixbuf;
+    guint8 *pixels;
+    guint len, i;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8, size, size);
+    pixels = gdk_pixbuf_get_pixels_with_length (pixbuf, &len);
+    for (i = 0; i < len; ++i)
+        pixels[i] = (guint8) g_random_int ();
+    return pixbuf;
+}
+
+/* what statusnotifier used to do */
+static guint8 *
+convert_cairo (GdkPixbuf *pixbuf, gsize *len)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    gint width, height, stride;
+    guint *data;
+    guint i, max;
+    guint8 *ret;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+    cr = cairo_create (surface);
+    gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    stride = cairo_image_surface_get_stride (surface);
+    cairo_surface_flush (surface);
+    data = (guint *) cairo_image_surface_get_data (surface);
+    max = (guint) (stride * height) / sizeof (guint);
+    for (i = 0; i < max; ++i)
+        data[i] = GUINT_TO_BE (data[i]);
+
+    *len = (gsize) (stride * height);
+    ret = g_malloc (*len);
+    memcpy (ret, data, *len);
+    cairo_surface_destroy (surface);
+    return ret;
+}
+
+static guint
+iterations_for (gint size)
+{
+    /* aim for roughly the same amount of pixels per measure */
+    return MAX (20, (guint) (4 * 1024 * 1024 / (size * size)));
+}
+
+int
+main (int argc, char *argv[])
+{
+    gboolean ok = TRUE;
+    guint s;
+
+    (void) argc;
+    (void) argv;
+
+    for (s = 0; s < G_N_ELEMENTS (sizes); ++s)
+    {
+        gint size = sizes[s];
+        guint n = iterations_for (size);
+        GdkPixbuf *pixbuf;
+        guint8 *ref, *out;
+        gsize len;
+        gint64 start;
+        guint i, impl;
+
+        pixbuf = random_pixbuf (size, TRUE);
+        ref = convert_cairo (pixbuf, &len);
+        out = g_malloc (len);
+
+        start = g_get_monotonic_time ();
+        for (i = 0; i < n; ++i)
+            g_free (convert_cairo (pixbuf, &len));
+        g_print ("pixmap-convert cairo %d %.0f\n", size,
+                (gdouble) (g_get_monotonic_time () - start) * 1000. / n);
+
+        for (impl = 0; impl < _NB_SN_PIXMAP_IMPLS; ++impl)
+        {
+            if (!sn_pixmap_impl_available (impl))
+                continue;
+
+            sn_pixmap_convert_with_impl (impl,
+                    gdk_pixbuf_read_pixels (pixbuf), size, size,
+                    gdk_pixbuf_get_rowstride (pixbuf), TRUE, out);
+            if (memcmp (ref, out, len) != 0)
+            {
+                g_printerr ("pixmap-convert: %s differs from cairo at size %d\n",
+                        sn_pixmap_impl_name (impl), size);
+                ok = FALSE;
+            }
+
+            start = g_get_monotonic_time ();
+            for (i = 0; i < n; ++i)
+                sn_pixmap_convert_with_impl (impl,
+                        gdk_pixbuf_read_pixels (pixbuf), size, size,
+                        gdk_pixbuf_get_rowstride (pixbuf), TRUE, out);
+            g_print ("pixmap-convert %s %d %.0f\n",
+                    sn_pixmap_impl_name (impl), size,
+                    (gdouble) (g_get_monotonic_time () - start) * 1000. / n);
+        }
+
+        g_free (ref);
+        g_free (out);
+        g_object_unref (pixbuf);
+    }
+
+    return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
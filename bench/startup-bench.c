@@ -0,0 +1,107 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * startup-bench.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Measures what parsing the introspection data costs, which statusnotifier
+ * used to do each time an item was registered (item interface) and the watcher
+ * appeared (watcher interface), before it parsed it once and shared it. Also
+ * measures property lookups GDBus then does on every Get, with and without the
+ * lookup cache built.
+ * Output is one line per measure:
+ *   <bench> <variant> <ns per operation>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <gio/gio.h>
+#include "interfaces.h"
+
+#define ITERATIONS      2000
+#define LOOKUPS         200000
+
+static const gchar * const props[] = {
+    "Id", "Category", "Title", "Status", "WindowId", "IconName", "IconPixmap",
+    "OverlayIconName", "OverlayIconPixmap", "AttentionIconName",
+    "AttentionIconPixmap", "AttentionMovieName", "ToolTip", "ItemIsMenu", "Menu"
+};
+
+static GDBusInterfaceInfo *
+parse (const gchar *xml)
+{
+    GDBusNodeInfo *node;
+    GDBusInterfaceInfo *info;
+
+    node = g_dbus_node_info_new_for_xml (xml, NULL);
+    info = g_dbus_interface_info_ref (node->interfaces[0]);
+    g_dbus_node_info_unref (node);
+    return info;
+}
+
+static void
+print (const gchar *bench, const gchar *variant, gint64 start, guint n)
+{
+    g_print ("%s %s %.0f\n", bench, variant,
+            (gdouble) (g_get_monotonic_time () - start) * 1000. / n);
+}
+
+static void
+bench_lookups (GDBusInterfaceInfo *info, const gchar *variant)
+{
+    gint64 start;
+    guint i;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < LOOKUPS; ++i)
+        if (!g_dbus_interface_info_lookup_property (info,
+                    props[i % G_N_ELEMENTS (props)]))
+            g_error ("Property %s not found", props[i % G_N_ELEMENTS (props)]);
+    print ("property-lookup", variant, start, LOOKUPS);
+}
+
+int
+main (int argc, char *argv[])
+{
+    GDBusInterfaceInfo *info;
+    gint64 start;
+    guint i;
+
+    (void) argc;
+    (void) argv;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < ITERATIONS; ++i)
+    {
+        g_dbus_interface_info_unref (parse (item_xml));
+        g_dbus_interface_info_unref (parse (watcher_xml));
+    }
+    print ("interface-info", "parse-each-time", start, ITERATIONS);
+
+    info = parse (item_xml);
+    bench_lookups (info, "uncached");
+    g_dbus_interface_info_cache_build (info);
+    bench_lookups (info, "cached");
+    g_dbus_interface_info_cache_release (info);
+    g_dbus_interface_info_unref (info);
+
+    return EXIT_SUCCESS;
+}
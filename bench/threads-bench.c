@@ -0,0 +1,239 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * threads-bench.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Calls setters of one item from several threads at once while its own thread
+ * runs the main loop, then checks the item ended up with one of the values set
+ * last, both locally and as seen over the bus. The item is registered against
+ * a mock StatusNotifierWatcher on a private bus (requires dbus-daemon), so
+ * setters do emit signals meanwhile.
+ * Build with -Db_sanitize=thread to have data races reported.
+ * Output is one line per measure:
+ *   <bench> <variant> <value>
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include "statusnotifier.h"
+#include "interfaces.h"
+#include "mock-watcher.h"
+
+#define _UNUSED_        __attribute__ ((unused))
+
+#define THREADS         8
+#define CALLS           20000
+
+typedef struct
+{
+    StatusNotifierItem *sn;
+    guint n;
+} Worker;
+
+static gint running = THREADS;
+
+static gpointer
+worker (gpointer data)
+{
+    StatusNotifierItem *sn = ((Worker *) data)->sn;
+    guint n = ((Worker *) data)->n;
+    guint i;
+
+    for (i = 0; i < CALLS; ++i)
+    {
+        gchar buf[32];
+
+        g_snprintf (buf, sizeof (buf), "t%u-%u", n, i);
+        if (i % 16 == 0)
+        {
+            status_notifier_item_begin_update (sn);
+            status_notifier_item_set_tooltip (sn, NULL, buf, NULL);
+            status_notifier_item_set_status (sn, (i % 32 == 0)
+                    ? STATUS_NOTIFIER_STATUS_ACTIVE
+                    : STATUS_NOTIFIER_STATUS_NEEDS_ATTENTION);
+            status_notifier_item_commit_update (sn);
+        }
+        status_notifier_item_set_title (sn, buf);
+    }
+
+    g_atomic_int_add (&running, -1);
+    g_main_context_wakeup (NULL);
+    return NULL;
+}
+
+static void
+notify_title (GObject *sn, GParamSpec *pspec, guint *notified)
+{
+    (void) sn;
+    (void) pspec;
+    ++*notified;
+}
+
+static void
+new_title (GDBusConnection *conn _UNUSED_,
+           const gchar     *sender _UNUSED_,
+           const gchar     *object _UNUSED_,
+           const gchar     *interface _UNUSED_,
+           const gchar     *signal _UNUSED_,
+           GVariant        *params _UNUSED_,
+           gpointer         data)
+{
+    ++*(guint *) data;
+}
+
+static void
+got_title (GObject *conn, GAsyncResult *res, gpointer data)
+{
+    GVariant **variant = data;
+    GError *err = NULL;
+
+    *variant = g_dbus_connection_call_finish ((GDBusConnection *) conn, res, &err);
+    if (!*variant)
+        g_error ("Failed to get Title: %s", err->message);
+}
+
+/* asks the item for its Title over the bus; async since it's served from the
+ * main context */
+static gchar *
+bus_title (void)
+{
+    GVariant *variant = NULL;
+    GVariant *value;
+    gchar *title;
+
+    g_mutex_lock (&mock.mutex);
+    g_dbus_connection_call (mock.conn, mock.item_name, mock.item_path,
+            "org.freedesktop.DBus.Properties", "Get",
+            g_variant_new ("(ss)", ITEM_INTERFACE, "Title"),
+            G_VARIANT_TYPE ("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+            got_title, &variant);
+    g_mutex_unlock (&mock.mutex);
+    while (!variant)
+        g_main_context_iteration (NULL, TRUE);
+
+    g_variant_get (variant, "(v)", &value);
+    title = g_variant_dup_string (value, NULL);
+    g_variant_unref (value);
+    g_variant_unref (variant);
+    return title;
+}
+
+static gboolean
+is_last (const gchar *title)
+{
+    guint n;
+
+    for (n = 0; n < THREADS; ++n)
+    {
+        gchar buf[32];
+
+        g_snprintf (buf, sizeof (buf), "t%u-%u", n, CALLS - 1);
+        if (title && strcmp (title, buf) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+int
+main (int argc, char *argv[])
+{
+    StatusNotifierItem *sn;
+    Worker workers[THREADS];
+    GThread *threads[THREADS];
+    GTestDBus *bus;
+    gchar *title, *remote;
+    guint notified = 0, received = 0;
+    gint64 start, elapsed;
+    gboolean ok;
+    guint id, n;
+
+    (void) argc;
+    (void) argv;
+
+    bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+    g_test_dbus_up (bus);
+    mock_start ();
+
+    sn = g_object_new (STATUS_NOTIFIER_TYPE_ITEM,
+            "id",               "threads-bench",
+            "title",            "threads-bench",
+            NULL);
+    g_signal_connect (sn, "notify::title", (GCallback) notify_title, &notified);
+
+    status_notifier_item_register (sn);
+    for (;;)
+    {
+        StatusNotifierState state = status_notifier_item_get_state (sn);
+
+        if (state == STATUS_NOTIFIER_STATE_REGISTERED)
+            break;
+        if (state == STATUS_NOTIFIER_STATE_FAILED)
+            g_error ("Registration failed");
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+    /* subscribed from here, so received in the main context */
+    g_mutex_lock (&mock.mutex);
+    id = g_dbus_connection_signal_subscribe (mock.conn, NULL, ITEM_INTERFACE,
+            "NewTitle", mock.item_path, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+            new_title, &received, NULL);
+    g_mutex_unlock (&mock.mutex);
+
+    start = g_get_monotonic_time ();
+    for (n = 0; n < THREADS; ++n)
+    {
+        workers[n].sn = sn;
+        workers[n].n = n;
+        threads[n] = g_thread_new ("setter", worker, &workers[n]);
+    }
+    while (g_atomic_int_get (&running) > 0)
+        g_main_context_iteration (NULL, TRUE);
+    for (n = 0; n < THREADS; ++n)
+        g_thread_join (threads[n]);
+    while (g_main_context_pending (NULL))
+        g_main_context_iteration (NULL, FALSE);
+    elapsed = MAX (1, g_get_monotonic_time () - start);
+
+    /* the reply comes after all signals emitted before it */
+    remote = bus_title ();
+    g_object_get (sn, "title", &title, NULL);
+    ok = is_last (title) && g_strcmp0 (title, remote) == 0;
+    if (!ok)
+        g_printerr ("threads-bench: unexpected final title %s (over the bus: %s)\n",
+                title, remote);
+
+    g_print ("threads setters %.0f\n",
+            (gdouble) THREADS * CALLS * G_USEC_PER_SEC / elapsed);
+    g_print ("threads title-notified %u\n", notified);
+    g_print ("threads title-signals %u\n", received);
+
+    g_dbus_connection_signal_unsubscribe (mock.conn, id);
+    g_free (title);
+    g_free (remote);
+    g_object_unref (sn);
+    mock_stop ();
+    g_test_dbus_down (bus);
+    g_object_unref (bus);
+    return (ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
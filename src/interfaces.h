@@ -33,6 +33,10 @@ G_BEGIN_DECLS
 #define ITEM_OBJECT         "/StatusNotifierItem"
 #define ITEM_INTERFACE      "org.kde.StatusNotifierItem"
 
+#define DEBUG_INTERFACE     "com.jjacky.StatusNotifier.Debug"
+
+#define MENU_INTERFACE      "com.canonical.dbusmenu"
+
 static const gchar watcher_xml[] =
     "<node>"
     "   <interface name='org.kde.StatusNotifierWatcher'>"
@@ -55,13 +59,13 @@ static const gchar item_xml[] =
     "       <property name='Status' type='s' access='read' />"
     "       <property name='WindowId' type='i' access='read' />"
     "       <property name='IconName' type='s' access='read' />"
-    "       <property name='IconPixmap' type='(iiay)' access='read' />"
+    "       <property name='IconPixmap' type='a(iiay)' access='read' />"
     "       <property name='OverlayIconName' type='s' access='read' />"
-    "       <property name='OverlayIconPixmap' type='(iiay)' access='read' />"
+    "       <property name='OverlayIconPixmap' type='a(iiay)' access='read' />"
     "       <property name='AttentionIconName' type='s' access='read' />"
-    "       <property name='AttentionIconPixmap' type='(iiay)' access='read' />"
+    "       <property name='AttentionIconPixmap' type='a(iiay)' access='read' />"
     "       <property name='AttentionMovieName' type='s' access='read' />"
-    "       <property name='ToolTip' type='(s(iiay)ss)' access='read' />"
+    "       <property name='ToolTip' type='(sa(iiay)ss)' access='read' />"
     "       <property name='ItemIsMenu' type='b' access='read' />"
     "       <property name='Menu' type='o' access='read' />"
     "       <method name='ContextMenu'>"
@@ -91,6 +95,73 @@ static const gchar item_xml[] =
     "   </interface>"
     "</node>";
 
+static const gchar debug_xml[] =
+    "<node>"
+    "   <interface name='com.jjacky.StatusNotifier.Debug'>"
+    "       <method name='GetStats'>"
+    "           <arg name='stats' type='a{sv}' direction='out' />"
+    "       </method>"
+    "   </interface>"
+    "</node>";
+
+static const gchar menu_xml[] =
+    "<node>"
+    "   <interface name='com.canonical.dbusmenu'>"
+    "       <property name='Version' type='u' access='read' />"
+    "       <property name='TextDirection' type='s' access='read' />"
+    "       <property name='Status' type='s' access='read' />"
+    "       <property name='IconThemePath' type='as' access='read' />"
+    "       <method name='GetLayout'>"
+    "           <arg name='parentId' type='i' direction='in' />"
+    "           <arg name='recursionDepth' type='i' direction='in' />"
+    "           <arg name='propertyNames' type='as' direction='in' />"
+    "           <arg name='revision' type='u' direction='out' />"
+    "           <arg name='layout' type='(ia{sv}av)' direction='out' />"
+    "       </method>"
+    "       <method name='GetGroupProperties'>"
+    "           <arg name='ids' type='ai' direction='in' />"
+    "           <arg name='propertyNames' type='as' direction='in' />"
+    "           <arg name='properties' type='a(ia{sv})' direction='out' />"
+    "       </method>"
+    "       <method name='GetProperty'>"
+    "           <arg name='id' type='i' direction='in' />"
+    "           <arg name='name' type='s' direction='in' />"
+    "           <arg name='value' type='v' direction='out' />"
+    "       </method>"
+    "       <method name='Event'>"
+    "           <arg name='id' type='i' direction='in' />"
+    "           <arg name='eventId' type='s' direction='in' />"
+    "           <arg name='data' type='v' direction='in' />"
+    "           <arg name='timestamp' type='u' direction='in' />"
+    "       </method>"
+    "       <method name='EventGroup'>"
+    "           <arg name='events' type='a(isvu)' direction='in' />"
+    "           <arg name='idErrors' type='ai' direction='out' />"
+    "       </method>"
+    "       <method name='AboutToShow'>"
+    "           <arg name='id' type='i' direction='in' />"
+    "           <arg name='needUpdate' type='b' direction='out' />"
+    "       </method>"
+    "       <method name='AboutToShowGroup'>"
+    "           <arg name='ids' type='ai' direction='in' />"
+    "           <arg name='updatesNeeded' type='ai' direction='out' />"
+    "           <arg name='idErrors' type='ai' direction='out' />"
+    "       </method>"
+    "       <signal name='ItemsPropertiesUpdated'>"
+    "           <arg name='updatedProps' type='a(ia{sv})' />"
+    "           <arg name='removedProps' type='a(ias)' />"
+    "       </signal>"
+    "       <signal name='LayoutUpdated'>"
+    "           <arg name='revision' type='u' />"
+    "           <arg name='parent' type='i' />"
+    "       </signal>"
+    "       <signal name='ItemActivationRequested'>"
+    "           <arg name='id' type='i' />"
+    "           <arg name='timestamp' type='u' />"
+    "       </signal>"
+    "   </interface>"
+    "</node>";
+
 G_END_DECLS
 
 #endif /* __INTERFACES_H__ */
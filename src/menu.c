@@ -0,0 +1,989 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * menu.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Exports a GMenuModel over DBus using the com.canonical.dbusmenu interface,
+ * without libdbusmenu (nor GTK). Items activate actions of a GActionGroup.
+ *
+ * Each item of the menu is a node with an id (0 for the root), sections being
+ * flattened into their parent with separators around them. Children of a node
+ * are only created when needed, and models they come from are watched so that
+ * when they change, the node's children are dropped (recreated when next
+ * needed) and LayoutUpdated is emitted for it, from an idle source so that
+ * many changes in a row (e.g. rebuilding a submenu) only result in one signal.
+ * Properties and (full) layouts
+ * of nodes are serialized once and kept until invalidated.
+ *
+ * Submenus can also be filled only once a host is about to show them (see
+ * sn_menu_set_fill_func()); until then they're simply empty.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include "menu.h"
+#include "interfaces.h"
+#include "private.h"
+
+#define _UNUSED_                __attribute__ ((unused))
+
+typedef struct _Node Node;
+struct _Node
+{
+    SnMenu *menu;
+    gint id;
+    /* NULL for the root */
+    Node *parent;
+    /* where the item is, NULL for the root and separators */
+    GMenuModel *model;
+    gint index;
+    /* submenu of the item, or the menu itself for the root */
+    GMenuModel *submenu;
+    /* action of the item and its target, if any */
+    gchar *action;
+    GVariant *target;
+    /* NULL until needed, see node_get_children() */
+    GPtrArray *children;
+    /* models children come from, watched for changes */
+    GPtrArray *watched;
+    /* a{sv} of properties, and (ia{sv}av) of the whole subtree with all
+     * properties, built on demand */
+    GVariant *props;
+    GVariant *layout;
+};
+
+#define is_separator(node)      ((node)->parent && !(node)->model)
+
+struct _SnMenu
+{
+    GMenuModel *model;
+    GActionGroup *actions;
+    gulong action_sids[4];
+    Node *root;
+    /* id -> Node, of all nodes created */
+    GHashTable *nodes;
+    gint last_id;
+    guint revision;
+
+    GDBusConnection *conn;
+    gchar *path;
+    guint reg_id;
+
+    SnMenuFillFunc fill;
+    gpointer fill_data;
+    /* node whose submenu fill is running for, see about_to_show() */
+    Node *filling;
+
+    /* Node -> properties hosts know of (a{sv}), for nodes whose properties
+     * might have changed, see emit_props_updated() */
+    GHashTable *dirty;
+    /* Nodes whose children changed, see emit_layout_updated() */
+    GHashTable *relayout;
+    /* idle source for flush_cb(), when either of the above isn't empty */
+    GSource *flush_source;
+
+    /* where method calls are dispatched, and flush_cb() runs */
+    GMainContext *context;
+};
+
+static void     add_items                           (SnMenu             *menu,
+                                                     Node               *node,
+                                                     GMenuModel         *model,
+                                                     gboolean           *separate);
+static gboolean flush_cb                            (gpointer            data);
+
+static Node *
+node_new (SnMenu *menu, Node *parent, GMenuModel *model, gint index)
+{
+    Node *node;
+
+    node = g_slice_new0 (Node);
+    node->menu = menu;
+    node->id = (parent) ? ++menu->last_id : 0;
+    node->parent = parent;
+    if (model)
+    {
+        node->model = g_object_ref (model);
+        node->index = index;
+        node->submenu = g_menu_model_get_item_link (model, index,
+                G_MENU_LINK_SUBMENU);
+        g_menu_model_get_item_attribute (model, index,
+                G_MENU_ATTRIBUTE_ACTION, "s", &node->action);
+        node->target = g_menu_model_get_item_attribute_value (model, index,
+                G_MENU_ATTRIBUTE_TARGET, NULL);
+    }
+    g_hash_table_insert (menu->nodes, GINT_TO_POINTER (node->id), node);
+    return node;
+}
+
+static void node_free (SnMenu *menu, Node *node);
+
+static void
+node_clear_children (SnMenu *menu, Node *node)
+{
+    guint i;
+
+    if (!node->children)
+        return;
+
+    for (i = 0; i < node->watched->len; ++i)
+        g_signal_handlers_disconnect_by_data (node->watched->pdata[i], node);
+    g_ptr_array_unref (node->watched);
+    node->watched = NULL;
+
+    for (i = 0; i < node->children->len; ++i)
+        node_free (menu, node->children->pdata[i]);
+    g_ptr_array_unref (node->children);
+    node->children = NULL;
+}
+
+static void
+node_free (SnMenu *menu, Node *node)
+{
+    node_clear_children (menu, node);
+    g_hash_table_remove (menu->nodes, GINT_TO_POINTER (node->id));
+    g_hash_table_remove (menu->dirty, node);
+    g_hash_table_remove (menu->relayout, node);
+
+    if (node->model)
+        g_object_unref (node->model);
+    if (node->submenu)
+        g_object_unref (node->submenu);
+    g_free (node->action);
+    if (node->target)
+        g_variant_unref (node->target);
+    if (node->props)
+        g_variant_unref (node->props);
+    if (node->layout)
+        g_variant_unref (node->layout);
+    g_slice_free (Node, node);
+}
+
+/* drops the cached layout of @node, and thus of all its ancestors */
+static void
+node_invalidate_layout (Node *node)
+{
+    for ( ; node; node = node->parent)
+        if (node->layout)
+        {
+            g_variant_unref (node->layout);
+            node->layout = NULL;
+        }
+}
+
+/* has flush_cb() called from the menu's context, unless already scheduled */
+static void
+schedule_flush (SnMenu *menu)
+{
+    if (menu->flush_source)
+        return;
+
+    menu->flush_source = g_idle_source_new ();
+    g_source_set_callback (menu->flush_source, flush_cb, menu, NULL);
+    g_source_attach (menu->flush_source, menu->context);
+    /* (owned by the context until dispatched or destroyed) */
+    g_source_unref (menu->flush_source);
+}
+
+static void
+items_changed (GMenuModel   *model _UNUSED_,
+               gint          position _UNUSED_,
+               gint          removed _UNUSED_,
+               gint          added _UNUSED_,
+               Node         *node)
+{
+    SnMenu *menu = node->menu;
+
+    /* indexes of children might not be valid anymore, simply start over */
+    node_clear_children (menu, node);
+    node_invalidate_layout (node);
+
+    /* hosts are told via the return value of AboutToShow */
+    if (menu->filling == node)
+        return;
+    g_hash_table_add (menu->relayout, node);
+    schedule_flush (menu);
+}
+
+static void
+add_child (SnMenu       *menu,
+           Node         *node,
+           GMenuModel   *model,
+           gint          index,
+           gboolean     *separate)
+{
+    if (*separate && node->children->len > 0)
+        g_ptr_array_add (node->children, node_new (menu, node, NULL, -1));
+    *separate = FALSE;
+    g_ptr_array_add (node->children, node_new (menu, node, model, index));
+}
+
+static void
+add_items (SnMenu *menu, Node *node, GMenuModel *model, gboolean *separate)
+{
+    gint n, i;
+
+    g_ptr_array_add (node->watched, g_object_ref (model));
+    g_signal_connect (model, "items-changed", (GCallback) items_changed, node);
+
+    n = g_menu_model_get_n_items (model);
+    for (i = 0; i < n; ++i)
+    {
+        GMenuModel *section;
+
+        section = g_menu_model_get_item_link (model, i, G_MENU_LINK_SECTION);
+        if (!section)
+        {
+            add_child (menu, node, model, i, separate);
+            continue;
+        }
+
+        /* separated from whatever is before & after */
+        *separate = TRUE;
+        add_items (menu, node, section, separate);
+        *separate = TRUE;
+        g_object_unref (section);
+    }
+}
+
+static GPtrArray *
+node_get_children (SnMenu *menu, Node *node)
+{
+    if (!node->children)
+    {
+        gboolean separate = FALSE;
+
+        node->children = g_ptr_array_new ();
+        node->watched = g_ptr_array_new_with_free_func (g_object_unref);
+        if (node->submenu)
+            add_items (menu, node, node->submenu, &separate);
+    }
+    return node->children;
+}
+
+/* name of the action of @node in menu->actions, or NULL */
+static const gchar *
+node_action (SnMenu *menu, Node *node)
+{
+    const gchar *dot;
+
+    if (!node->action || !menu->actions)
+        return NULL;
+    if (g_action_group_has_action (menu->actions, node->action))
+        return node->action;
+    /* e.g. "app.quit" with the actions of the application */
+    dot = strchr (node->action, '.');
+    if (dot && g_action_group_has_action (menu->actions, dot + 1))
+        return dot + 1;
+    return NULL;
+}
+
+static gboolean
+node_uses_action (Node *node, const gchar *name)
+{
+    const gchar *dot;
+
+    if (!node->action)
+        return FALSE;
+    if (!strcmp (node->action, name))
+        return TRUE;
+    dot = strchr (node->action, '.');
+    return dot && !strcmp (dot + 1, name);
+}
+
+/* only non-default values are included */
+static GVariant *
+build_props (SnMenu *menu, Node *node)
+{
+    GVariantBuilder builder;
+    const gchar *name;
+    gchar *s;
+    GVariant *v;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    if (!node->parent)
+    {
+        g_variant_builder_add (&builder, "{sv}", "children-display",
+                g_variant_new_string ("submenu"));
+        return g_variant_builder_end (&builder);
+    }
+    if (is_separator (node))
+    {
+        g_variant_builder_add (&builder, "{sv}", "type",
+                g_variant_new_string ("separator"));
+        return g_variant_builder_end (&builder);
+    }
+
+    if (g_menu_model_get_item_attribute (node->model, node->index,
+                G_MENU_ATTRIBUTE_LABEL, "s", &s))
+        g_variant_builder_add (&builder, "{sv}", "label",
+                g_variant_new_take_string (s));
+
+    v = g_menu_model_get_item_attribute_value (node->model, node->index,
+            G_MENU_ATTRIBUTE_ICON, NULL);
+    if (v)
+    {
+        GIcon *icon = g_icon_deserialize (v);
+
+        if (icon && G_IS_THEMED_ICON (icon))
+            g_variant_builder_add (&builder, "{sv}", "icon-name",
+                    g_variant_new_string (
+                        g_themed_icon_get_names ((GThemedIcon *) icon)[0]));
+        if (icon)
+            g_object_unref (icon);
+        g_variant_unref (v);
+    }
+
+    if (node->submenu)
+        g_variant_builder_add (&builder, "{sv}", "children-display",
+                g_variant_new_string ("submenu"));
+
+    name = node_action (menu, node);
+    if (name)
+    {
+        GVariant *state;
+
+        if (!g_action_group_get_action_enabled (menu->actions, name))
+        {
+            g_variant_builder_add (&builder, "{sv}", "enabled",
+                    g_variant_new_boolean (FALSE));
+            if (g_menu_model_get_item_attribute (node->model, node->index,
+                        "hidden-when", "s", &s))
+            {
+                if (!strcmp (s, "action-disabled"))
+                    g_variant_builder_add (&builder, "{sv}", "visible",
+                            g_variant_new_boolean (FALSE));
+                g_free (s);
+            }
+        }
+
+        state = g_action_group_get_action_state (menu->actions, name);
+        if (state)
+        {
+            if (node->target && g_variant_is_of_type (state,
+                        g_variant_get_type (node->target)))
+            {
+                g_variant_builder_add (&builder, "{sv}", "toggle-type",
+                        g_variant_new_string ("radio"));
+                g_variant_builder_add (&builder, "{sv}", "toggle-state",
+                        g_variant_new_int32 (g_variant_equal (state, node->target)));
+            }
+            else if (!node->target
+                    && g_variant_is_of_type (state, G_VARIANT_TYPE_BOOLEAN))
+            {
+                g_variant_builder_add (&builder, "{sv}", "toggle-type",
+                        g_variant_new_string ("checkmark"));
+                g_variant_builder_add (&builder, "{sv}", "toggle-state",
+                        g_variant_new_int32 (g_variant_get_boolean (state)));
+            }
+            g_variant_unref (state);
+        }
+    }
+    else if (!node->submenu)
+    {
+        /* no (known) action, nothing to do: same as GTK */
+        g_variant_builder_add (&builder, "{sv}", "enabled",
+                g_variant_new_boolean (FALSE));
+        if (node->action && g_menu_model_get_item_attribute (node->model,
+                    node->index, "hidden-when", "s", &s))
+        {
+            if (!strcmp (s, "action-missing") || !strcmp (s, "action-disabled"))
+                g_variant_builder_add (&builder, "{sv}", "visible",
+                        g_variant_new_boolean (FALSE));
+            g_free (s);
+        }
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+node_get_props (SnMenu *menu, Node *node)
+{
+    if (!node->props)
+        node->props = g_variant_ref_sink (build_props (menu, node));
+    return node->props;
+}
+
+/* properties of @node, only those in @names if not NULL */
+static GVariant *
+node_filter_props (SnMenu *menu, Node *node, const gchar * const *names)
+{
+    GVariantBuilder builder;
+    GVariant *props;
+    guint i;
+
+    props = node_get_props (menu, node);
+    if (!names)
+        return g_variant_ref (props);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    for (i = 0; names[i]; ++i)
+    {
+        GVariant *value = g_variant_lookup_value (props, names[i], NULL);
+
+        if (value)
+        {
+            g_variant_builder_add (&builder, "{sv}", names[i], value);
+            g_variant_unref (value);
+        }
+    }
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/* returns the (ia{sv}av) layout of @node down to @depth levels (-1 for all),
+ * with properties in @names (NULL for all) */
+static GVariant *
+node_get_layout (SnMenu *menu, Node *node, gint depth, const gchar * const *names)
+{
+    gboolean full = depth < 0 && !names;
+    GVariantBuilder children;
+    GVariant *props;
+    GVariant *layout;
+
+    if (full && node->layout)
+        return g_variant_ref (node->layout);
+
+    g_variant_builder_init (&children, G_VARIANT_TYPE ("av"));
+    if (depth != 0 && node->submenu)
+    {
+        GPtrArray *arr = node_get_children (menu, node);
+        guint i;
+
+        for (i = 0; i < arr->len; ++i)
+        {
+            GVariant *child;
+
+            child = node_get_layout (menu, arr->pdata[i],
+                    (depth < 0) ? depth : depth - 1, names);
+            g_variant_builder_add (&children, "v", child);
+            g_variant_unref (child);
+        }
+    }
+
+    props = node_filter_props (menu, node, names);
+    layout = g_variant_ref_sink (g_variant_new ("(i@a{sv}av)",
+                node->id, props, &children));
+    g_variant_unref (props);
+
+    if (full)
+        node->layout = g_variant_ref (layout);
+    return layout;
+}
+
+/* emits LayoutUpdated for nodes whose children changed, only once for a
+ * subtree (i.e. not for those with an ancestor also changed) */
+static void
+emit_layout_updated (SnMenu *menu)
+{
+    GHashTableIter iter;
+    gpointer key;
+
+    if (g_hash_table_size (menu->relayout) == 0)
+        return;
+
+    ++menu->revision;
+    g_hash_table_iter_init (&iter, menu->relayout);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        Node *node = key;
+        Node *parent;
+
+        for (parent = node->parent;
+                parent && !g_hash_table_contains (menu->relayout, parent);
+                parent = parent->parent)
+            ;
+        if (parent || menu->reg_id == 0)
+            continue;
+
+        g_dbus_connection_emit_signal (menu->conn, NULL, menu->path,
+                MENU_INTERFACE, "LayoutUpdated",
+                g_variant_new ("(ui)", menu->revision, node->id),
+                NULL);
+    }
+    g_hash_table_remove_all (menu->relayout);
+}
+
+/* emits ItemsPropertiesUpdated for nodes whose properties changed */
+static void
+emit_props_updated (SnMenu *menu)
+{
+    GVariantBuilder updated;
+    GVariantBuilder removed;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean emit = FALSE;
+
+    g_variant_builder_init (&updated, G_VARIANT_TYPE ("a(ia{sv})"));
+    g_variant_builder_init (&removed, G_VARIANT_TYPE ("a(ias)"));
+    g_hash_table_iter_init (&iter, menu->dirty);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        Node *node = key;
+        GVariant *old = value;
+        GVariant *props = node_get_props (menu, node);
+        GVariantBuilder b_updated;
+        GVariantBuilder b_removed;
+        GVariantIter it;
+        const gchar *name;
+        GVariant *v;
+        gboolean has_updated = FALSE, has_removed = FALSE;
+
+        g_variant_builder_init (&b_updated, G_VARIANT_TYPE_VARDICT);
+        g_variant_iter_init (&it, props);
+        while (g_variant_iter_next (&it, "{&sv}", &name, &v))
+        {
+            GVariant *old_v = g_variant_lookup_value (old, name, NULL);
+
+            if (!old_v || !g_variant_equal (old_v, v))
+            {
+                g_variant_builder_add (&b_updated, "{sv}", name, v);
+                has_updated = TRUE;
+            }
+            if (old_v)
+                g_variant_unref (old_v);
+            g_variant_unref (v);
+        }
+
+        /* those not set anymore are back to their default */
+        g_variant_builder_init (&b_removed, G_VARIANT_TYPE_STRING_ARRAY);
+        g_variant_iter_init (&it, old);
+        while (g_variant_iter_next (&it, "{&sv}", &name, &v))
+        {
+            GVariant *new_v = g_variant_lookup_value (props, name, NULL);
+
+            if (new_v)
+                g_variant_unref (new_v);
+            else
+            {
+                g_variant_builder_add (&b_removed, "s", name);
+                has_removed = TRUE;
+            }
+            g_variant_unref (v);
+        }
+
+        if (has_updated)
+            g_variant_builder_add (&updated, "(ia{sv})", node->id, &b_updated);
+        else
+            g_variant_builder_clear (&b_updated);
+        if (has_removed)
+            g_variant_builder_add (&removed, "(ias)", node->id, &b_removed);
+        else
+            g_variant_builder_clear (&b_removed);
+        emit = emit || has_updated || has_removed;
+    }
+    g_hash_table_remove_all (menu->dirty);
+
+    if (emit && menu->reg_id > 0)
+        g_dbus_connection_emit_signal (menu->conn, NULL, menu->path,
+                MENU_INTERFACE, "ItemsPropertiesUpdated",
+                g_variant_new ("(a(ia{sv})a(ias))", &updated, &removed),
+                NULL);
+    else
+    {
+        g_variant_builder_clear (&updated);
+        g_variant_builder_clear (&removed);
+    }
+}
+
+static gboolean
+flush_cb (gpointer data)
+{
+    SnMenu *menu = data;
+
+    menu->flush_source = NULL;
+    emit_layout_updated (menu);
+    emit_props_updated (menu);
+    return G_SOURCE_REMOVE;
+}
+
+/* properties of nodes using action @name might have changed */
+static void
+action_changed (SnMenu *menu, const gchar *name)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init (&iter, menu->nodes);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        Node *node = value;
+
+        if (!node_uses_action (node, name))
+            continue;
+
+        /* hosts can't know of properties never serialized */
+        if (node->props && !g_hash_table_contains (menu->dirty, node))
+            g_hash_table_insert (menu->dirty, node, node->props);
+        else if (node->props)
+            g_variant_unref (node->props);
+        node->props = NULL;
+        node_invalidate_layout (node);
+    }
+
+    if (g_hash_table_size (menu->dirty) > 0)
+        schedule_flush (menu);
+}
+
+static void
+action_added (GActionGroup *actions _UNUSED_, const gchar *name, SnMenu *menu)
+{
+    action_changed (menu, name);
+}
+
+static void
+action_enabled_changed (GActionGroup   *actions _UNUSED_,
+                        const gchar    *name,
+                        gboolean        enabled _UNUSED_,
+                        SnMenu         *menu)
+{
+    action_changed (menu, name);
+}
+
+static void
+action_state_changed (GActionGroup  *actions _UNUSED_,
+                      const gchar   *name,
+                      GVariant      *state _UNUSED_,
+                      SnMenu        *menu)
+{
+    action_changed (menu, name);
+}
+
+static gboolean
+handle_event (SnMenu *menu, gint id, const gchar *event)
+{
+    Node *node;
+    const gchar *name;
+
+    node = g_hash_table_lookup (menu->nodes, GINT_TO_POINTER (id));
+    if (!node)
+        return FALSE;
+
+    /* "opened", "closed" and "hovered" need nothing from us */
+    if (strcmp (event, "clicked") != 0)
+        return TRUE;
+
+    name = node_action (menu, node);
+    if (name && g_action_group_get_action_enabled (menu->actions, name))
+        g_action_group_activate_action (menu->actions, name, node->target);
+    return TRUE;
+}
+
+/* returns 1 if the submenu of item @id changed, 0 if not, -1 if there's no
+ * such item */
+static gint
+about_to_show (SnMenu *menu, gint id)
+{
+    Node *node;
+    gboolean changed;
+
+    node = g_hash_table_lookup (menu->nodes, GINT_TO_POINTER (id));
+    if (!node)
+        return -1;
+    if (!node->submenu || !menu->fill)
+        return 0;
+
+    /* no LayoutUpdated for each item added, the return value says it all */
+    menu->filling = node;
+    changed = menu->fill (node->submenu, menu->fill_data);
+    menu->filling = NULL;
+    return changed;
+}
+
+static void
+method_call (GDBusConnection        *conn _UNUSED_,
+             const gchar            *sender _UNUSED_,
+             const gchar            *object _UNUSED_,
+             const gchar            *interface _UNUSED_,
+             const gchar            *method,
+             GVariant               *params,
+             GDBusMethodInvocation  *invocation,
+             gpointer                data)
+{
+    SnMenu *menu = data;
+    Node *node;
+    gint id;
+
+    if (!strcmp (method, "GetLayout"))
+    {
+        const gchar **names;
+        GVariant *layout;
+        gint depth;
+
+        g_variant_get (params, "(ii^a&s)", &id, &depth, &names);
+        node = g_hash_table_lookup (menu->nodes, GINT_TO_POINTER (id));
+        if (!node)
+        {
+            g_free (names);
+            goto unknown;
+        }
+
+        layout = node_get_layout (menu, node, depth,
+                (names && *names) ? names : NULL);
+        g_free (names);
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(u@(ia{sv}av))", menu->revision, layout));
+        g_variant_unref (layout);
+    }
+    else if (!strcmp (method, "GetGroupProperties"))
+    {
+        GVariantBuilder builder;
+        GVariantIter *ids;
+        const gchar **names;
+
+        g_variant_get (params, "(ai^a&s)", &ids, &names);
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ia{sv})"));
+        while (g_variant_iter_next (ids, "i", &id))
+        {
+            GVariant *props;
+
+            node = g_hash_table_lookup (menu->nodes, GINT_TO_POINTER (id));
+            if (!node)
+                continue;
+            props = node_filter_props (menu, node,
+                    (names && *names) ? names : NULL);
+            g_variant_builder_add (&builder, "(i@a{sv})", id, props);
+            g_variant_unref (props);
+        }
+        g_variant_iter_free (ids);
+        g_free (names);
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(a(ia{sv}))", &builder));
+    }
+    else if (!strcmp (method, "GetProperty"))
+    {
+        const gchar *name;
+        GVariant *value;
+
+        g_variant_get (params, "(i&s)", &id, &name);
+        node = g_hash_table_lookup (menu->nodes, GINT_TO_POINTER (id));
+        if (!node)
+            goto unknown;
+
+        value = g_variant_lookup_value (node_get_props (menu, node), name, NULL);
+        if (!value)
+        {
+            g_dbus_method_invocation_return_error (invocation,
+                    G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "Property %s not set on item %d", name, id);
+            return;
+        }
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(v)", value));
+        g_variant_unref (value);
+    }
+    else if (!strcmp (method, "Event"))
+    {
+        const gchar *event;
+
+        g_variant_get (params, "(i&svu)", &id, &event, NULL, NULL);
+        if (!handle_event (menu, id, event))
+            goto unknown;
+        g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+    else if (!strcmp (method, "EventGroup"))
+    {
+        GVariantBuilder errors;
+        GVariantIter *events;
+        const gchar *event;
+
+        g_variant_get (params, "(a(isvu))", &events);
+        g_variant_builder_init (&errors, G_VARIANT_TYPE ("ai"));
+        while (g_variant_iter_next (events, "(i&svu)", &id, &event, NULL, NULL))
+            if (!handle_event (menu, id, event))
+                g_variant_builder_add (&errors, "i", id);
+        g_variant_iter_free (events);
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(ai)", &errors));
+    }
+    else if (!strcmp (method, "AboutToShow"))
+    {
+        gint changed;
+
+        g_variant_get (params, "(i)", &id);
+        changed = about_to_show (menu, id);
+        if (changed < 0)
+            goto unknown;
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(b)", changed));
+    }
+    else /* AboutToShowGroup */
+    {
+        GVariantBuilder updates;
+        GVariantBuilder errors;
+        GVariantIter *ids;
+
+        g_variant_get (params, "(ai)", &ids);
+        g_variant_builder_init (&updates, G_VARIANT_TYPE ("ai"));
+        g_variant_builder_init (&errors, G_VARIANT_TYPE ("ai"));
+        while (g_variant_iter_next (ids, "i", &id))
+        {
+            gint changed = about_to_show (menu, id);
+
+            if (changed < 0)
+                g_variant_builder_add (&errors, "i", id);
+            else if (changed)
+                g_variant_builder_add (&updates, "i", id);
+        }
+        g_variant_iter_free (ids);
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(aiai)", &updates, &errors));
+    }
+    return;
+
+unknown:
+    g_dbus_method_invocation_return_error (invocation,
+            G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+            "Unknown item %d", id);
+}
+
+static GVariant *
+get_property (GDBusConnection        *conn _UNUSED_,
+              const gchar            *sender _UNUSED_,
+              const gchar            *object _UNUSED_,
+              const gchar            *interface _UNUSED_,
+              const gchar            *property,
+              GError                **error _UNUSED_,
+              gpointer                data _UNUSED_)
+{
+    if (!strcmp (property, "Version"))
+        return g_variant_new_uint32 (3);
+    else if (!strcmp (property, "TextDirection"))
+        return g_variant_new_string ("ltr");
+    else if (!strcmp (property, "Status"))
+        return g_variant_new_string ("normal");
+    else /* IconThemePath */
+        return g_variant_new_strv (NULL, 0);
+}
+
+static const GDBusInterfaceVTable menu_vtable = {
+    .method_call = method_call,
+    .get_property = get_property,
+    .set_property = NULL
+};
+
+SnMenu *
+sn_menu_new (GMenuModel *model, GActionGroup *actions, GMainContext *context)
+{
+    SnMenu *menu;
+
+    menu = g_slice_new0 (SnMenu);
+    menu->context = g_main_context_ref (context);
+    menu->model = g_object_ref (model);
+    menu->nodes = g_hash_table_new (g_direct_hash, g_direct_equal);
+    menu->dirty = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+            NULL, (GDestroyNotify) g_variant_unref);
+    menu->relayout = g_hash_table_new (g_direct_hash, g_direct_equal);
+    menu->root = node_new (menu, NULL, NULL, -1);
+    menu->root->submenu = g_object_ref (model);
+
+    if (actions)
+    {
+        menu->actions = g_object_ref (actions);
+        menu->action_sids[0] = g_signal_connect (actions, "action-added",
+                (GCallback) action_added, menu);
+        menu->action_sids[1] = g_signal_connect (actions, "action-removed",
+                (GCallback) action_added, menu);
+        menu->action_sids[2] = g_signal_connect (actions, "action-enabled-changed",
+                (GCallback) action_enabled_changed, menu);
+        menu->action_sids[3] = g_signal_connect (actions, "action-state-changed",
+                (GCallback) action_state_changed, menu);
+    }
+
+    return menu;
+}
+
+void
+sn_menu_free (SnMenu *menu)
+{
+    guint i;
+
+    sn_menu_unexport (menu);
+    if (menu->flush_source)
+        g_source_destroy (menu->flush_source);
+    if (menu->actions)
+    {
+        for (i = 0; i < G_N_ELEMENTS (menu->action_sids); ++i)
+            g_signal_handler_disconnect (menu->actions, menu->action_sids[i]);
+        g_object_unref (menu->actions);
+    }
+    node_free (menu, menu->root);
+    g_hash_table_unref (menu->nodes);
+    g_hash_table_unref (menu->dirty);
+    g_hash_table_unref (menu->relayout);
+    g_object_unref (menu->model);
+    g_main_context_unref (menu->context);
+    g_slice_free (SnMenu, menu);
+}
+
+GMenuModel *
+sn_menu_get_model (SnMenu *menu)
+{
+    return menu->model;
+}
+
+gboolean
+sn_menu_export (SnMenu             *menu,
+                GDBusConnection    *conn,
+                const gchar        *path,
+                GError            **error)
+{
+    sn_menu_unexport (menu);
+
+    menu->reg_id = g_dbus_connection_register_object (conn, path,
+            _status_notifier_get_menu_interface_info (),
+            &menu_vtable,
+            menu, NULL,
+            error);
+    if (menu->reg_id == 0)
+        return FALSE;
+
+    menu->conn = g_object_ref (conn);
+    menu->path = g_strdup (path);
+    return TRUE;
+}
+
+void
+sn_menu_unexport (SnMenu *menu)
+{
+    if (menu->reg_id == 0)
+        return;
+
+    g_dbus_connection_unregister_object (menu->conn, menu->reg_id);
+    menu->reg_id = 0;
+    g_clear_object (&menu->conn);
+    g_free (menu->path);
+    menu->path = NULL;
+}
+
+const gchar *
+sn_menu_get_path (SnMenu *menu)
+{
+    return menu->path;
+}
+
+void
+sn_menu_set_fill_func (SnMenu *menu, SnMenuFillFunc func, gpointer data)
+{
+    menu->fill = func;
+    menu->fill_data = data;
+}
@@ -0,0 +1,52 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * menu.h
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef __MENU_H__
+#define __MENU_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _SnMenu SnMenu;
+
+/* called when a host is about to show @submenu, returns whether it changed */
+typedef gboolean (*SnMenuFillFunc) (GMenuModel *submenu, gpointer data);
+
+SnMenu *        sn_menu_new                 (GMenuModel         *model,
+                                             GActionGroup       *actions,
+                                             GMainContext       *context);
+void            sn_menu_free                (SnMenu             *menu);
+GMenuModel *    sn_menu_get_model           (SnMenu             *menu);
+gboolean        sn_menu_export              (SnMenu             *menu,
+                                             GDBusConnection    *conn,
+                                             const gchar        *path,
+                                             GError            **error);
+void            sn_menu_unexport            (SnMenu             *menu);
+const gchar *   sn_menu_get_path            (SnMenu             *menu);
+void            sn_menu_set_fill_func       (SnMenu             *menu,
+                                             SnMenuFillFunc      func,
+                                             gpointer            data);
+
+G_END_DECLS
+
+#endif /* __MENU_H__ */
@@ -0,0 +1,361 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * pixmap.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Conversion of GdkPixbuf data into the format used by the StatusNotifierItem
+ * pixmap properties: ARGB32, in network byte order. Colors are premultiplied
+ * by alpha, so the result is byte-for-byte what painting the pixbuf onto a
+ * cairo ARGB32 surface and swapping it to big endian used to give us, only in
+ * a single pass and without any intermediate surface.
+ */
+
+#include "config.h"
+
+#include "pixmap.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD   1
+#include <immintrin.h>
+#else
+#define HAVE_X86_SIMD   0
+#endif
+
+#if defined(__aarch64__) || (defined(__ARM_NEON) && defined(__arm__))
+#define HAVE_NEON       1
+#include <arm_neon.h>
+#else
+#define HAVE_NEON       0
+#endif
+
+typedef void (*convert_row_fn) (const guint8 *src, guint8 *dst, gint width);
+
+/* same rounding as cairo/gdk, so we get identical results */
+#define PREMUL(c,a)     ((((guint) (c) * (a) + 0x80) + (((guint) (c) * (a) + 0x80) >> 8)) >> 8)
+
+static void
+convert_row_rgb (const guint8 *src, guint8 *dst, gint width)
+{
+    gint i;
+
+    for (i = 0; i < width; ++i, src += 3, dst += 4)
+    {
+        dst[0] = 0xff;
+        dst[1] = src[0];
+        dst[2] = src[1];
+        dst[3] = src[2];
+    }
+}
+
+static void
+convert_row_rgba_scalar (const guint8 *src, guint8 *dst, gint width)
+{
+    gint i;
+
+    for (i = 0; i < width; ++i, src += 4, dst += 4)
+    {
+        guint a = src[3];
+
+        dst[0] = (guint8) a;
+        if (a == 0xff)
+        {
+            dst[1] = src[0];
+            dst[2] = src[1];
+            dst[3] = src[2];
+        }
+        else if (a == 0)
+            dst[1] = dst[2] = dst[3] = 0;
+        else
+        {
+            dst[1] = (guint8) PREMUL (src[0], a);
+            dst[2] = (guint8) PREMUL (src[1], a);
+            dst[3] = (guint8) PREMUL (src[2], a);
+        }
+    }
+}
+
+#if HAVE_X86_SIMD
+
+/* @v holds 2 pixels as 16bit RGBA lanes; returns them premultiplied and
+ * reordered as ARGB */
+__attribute__ ((target ("sse2")))
+static inline __m128i
+premul_argb_sse2 (__m128i v)
+{
+    const __m128i mask_rgb = _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i mask_a = _mm_set_epi16 (0xff, 0, 0, 0, 0xff, 0, 0, 0);
+    const __m128i round = _mm_set1_epi16 (0x80);
+    __m128i alpha, t;
+
+    alpha = _mm_shufflelo_epi16 (v, _MM_SHUFFLE (3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16 (alpha, _MM_SHUFFLE (3, 3, 3, 3));
+    /* alpha itself gets "multiplied" by 255, i.e. left untouched */
+    alpha = _mm_or_si128 (_mm_and_si128 (alpha, mask_rgb), mask_a);
+
+    t = _mm_add_epi16 (_mm_mullo_epi16 (v, alpha), round);
+    t = _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+
+    t = _mm_shufflelo_epi16 (t, _MM_SHUFFLE (2, 1, 0, 3));
+    return _mm_shufflehi_epi16 (t, _MM_SHUFFLE (2, 1, 0, 3));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+convert_row_rgba_sse2 (const guint8 *src, guint8 *dst, gint width)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    gint i;
+
+    for (i = 0; i + 4 <= width; i += 4, src += 16, dst += 16)
+    {
+        __m128i px, lo, hi;
+
+        px = _mm_loadu_si128 ((const __m128i *) src);
+        lo = premul_argb_sse2 (_mm_unpacklo_epi8 (px, zero));
+        hi = premul_argb_sse2 (_mm_unpackhi_epi8 (px, zero));
+        _mm_storeu_si128 ((__m128i *) dst, _mm_packus_epi16 (lo, hi));
+    }
+    convert_row_rgba_scalar (src, dst, width - i);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+premul_argb_avx2 (__m256i v)
+{
+    const __m256i mask_rgb = _mm256_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1,
+                                               0, -1, -1, -1, 0, -1, -1, -1);
+    const __m256i mask_a = _mm256_set_epi16 (0xff, 0, 0, 0, 0xff, 0, 0, 0,
+                                             0xff, 0, 0, 0, 0xff, 0, 0, 0);
+    const __m256i round = _mm256_set1_epi16 (0x80);
+    __m256i alpha, t;
+
+    alpha = _mm256_shufflelo_epi16 (v, _MM_SHUFFLE (3, 3, 3, 3));
+    alpha = _mm256_shufflehi_epi16 (alpha, _MM_SHUFFLE (3, 3, 3, 3));
+    alpha = _mm256_or_si256 (_mm256_and_si256 (alpha, mask_rgb), mask_a);
+
+    t = _mm256_add_epi16 (_mm256_mullo_epi16 (v, alpha), round);
+    t = _mm256_srli_epi16 (_mm256_add_epi16 (t, _mm256_srli_epi16 (t, 8)), 8);
+
+    t = _mm256_shufflelo_epi16 (t, _MM_SHUFFLE (2, 1, 0, 3));
+    return _mm256_shufflehi_epi16 (t, _MM_SHUFFLE (2, 1, 0, 3));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+convert_row_rgba_avx2 (const guint8 *src, guint8 *dst, gint width)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    gint i;
+
+    /* unpack/pack work within 128bit lanes, so pixel order is preserved */
+    for (i = 0; i + 8 <= width; i += 8, src += 32, dst += 32)
+    {
+        __m256i px, lo, hi;
+
+        px = _mm256_loadu_si256 ((const __m256i *) src);
+        lo = premul_argb_avx2 (_mm256_unpacklo_epi8 (px, zero));
+        hi = premul_argb_avx2 (_mm256_unpackhi_epi8 (px, zero));
+        _mm256_storeu_si256 ((__m256i *) dst, _mm256_packus_epi16 (lo, hi));
+    }
+    convert_row_rgba_scalar (src, dst, width - i);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+#if HAVE_NEON
+
+static inline uint8x8_t
+premul_neon (uint8x8_t c, uint8x8_t a)
+{
+    uint16x8_t t;
+
+    t = vaddq_u16 (vmull_u8 (c, a), vdupq_n_u16 (0x80));
+    return vshrn_n_u16 (vaddq_u16 (t, vshrq_n_u16 (t, 8)), 8);
+}
+
+static void
+convert_row_rgba_neon (const guint8 *src, guint8 *dst, gint width)
+{
+    gint i;
+
+    for (i = 0; i + 8 <= width; i += 8, src += 32, dst += 32)
+    {
+        uint8x8x4_t px = vld4_u8 (src);
+        uint8x8x4_t out;
+
+        out.val[0] = px.val[3];
+        out.val[1] = premul_neon (px.val[0], px.val[3]);
+        out.val[2] = premul_neon (px.val[1], px.val[3]);
+        out.val[3] = premul_neon (px.val[2], px.val[3]);
+        vst4_u8 (dst, out);
+    }
+    convert_row_rgba_scalar (src, dst, width - i);
+}
+
+#endif /* HAVE_NEON */
+
+static const gchar * const impl_names[_NB_SN_PIXMAP_IMPLS] = {
+    "scalar",
+    "sse2",
+    "avx2",
+    "neon"
+};
+
+const gchar *
+sn_pixmap_impl_name (SnPixmapImpl impl)
+{
+    g_return_val_if_fail (impl < _NB_SN_PIXMAP_IMPLS, NULL);
+    return impl_names[impl];
+}
+
+gboolean
+sn_pixmap_impl_available (SnPixmapImpl impl)
+{
+    switch (impl)
+    {
+        case SN_PIXMAP_IMPL_SCALAR:
+            return TRUE;
+#if HAVE_X86_SIMD
+        case SN_PIXMAP_IMPL_SSE2:
+            __builtin_cpu_init ();
+            return __builtin_cpu_supports ("sse2");
+        case SN_PIXMAP_IMPL_AVX2:
+            __builtin_cpu_init ();
+            return __builtin_cpu_supports ("avx2");
+#endif
+#if HAVE_NEON
+        case SN_PIXMAP_IMPL_NEON:
+            return TRUE;
+#endif
+        default:
+            return FALSE;
+    }
+}
+
+static convert_row_fn
+get_convert_row (SnPixmapImpl impl)
+{
+    switch (impl)
+    {
+#if HAVE_X86_SIMD
+        case SN_PIXMAP_IMPL_SSE2:
+            return convert_row_rgba_sse2;
+        case SN_PIXMAP_IMPL_AVX2:
+            return convert_row_rgba_avx2;
+#endif
+#if HAVE_NEON
+        case SN_PIXMAP_IMPL_NEON:
+            return convert_row_rgba_neon;
+#endif
+        default:
+            return convert_row_rgba_scalar;
+    }
+}
+
+/* picks the best implementation available on the running CPU, once */
+SnPixmapImpl
+sn_pixmap_get_impl (void)
+{
+    static gsize impl = 0;
+
+    if (g_once_init_enter (&impl))
+    {
+        SnPixmapImpl best = SN_PIXMAP_IMPL_SCALAR;
+
+        if (sn_pixmap_impl_available (SN_PIXMAP_IMPL_NEON))
+            best = SN_PIXMAP_IMPL_NEON;
+        else if (sn_pixmap_impl_available (SN_PIXMAP_IMPL_AVX2))
+            best = SN_PIXMAP_IMPL_AVX2;
+        else if (sn_pixmap_impl_available (SN_PIXMAP_IMPL_SSE2))
+            best = SN_PIXMAP_IMPL_SSE2;
+
+        /* +1 so that SN_PIXMAP_IMPL_SCALAR isn't 0 */
+        g_once_init_leave (&impl, (gsize) best + 1);
+    }
+
+    return (SnPixmapImpl) (impl - 1);
+}
+
+/* converts pixbuf data (8 bits per sample, RGB or RGBA) to network order
+ * premultiplied ARGB32. @dest must be able to hold width * height * 4 bytes */
+void
+sn_pixmap_convert_with_impl (SnPixmapImpl        impl,
+                             const guint8       *src,
+                             gint                width,
+                             gint                height,
+                             gint                rowstride,
+                             gboolean            has_alpha,
+                             guint8             *dest)
+{
+    convert_row_fn convert_row;
+    gint y;
+
+    if (!has_alpha)
+        convert_row = convert_row_rgb;
+    else
+        convert_row = get_convert_row (impl);
+
+    for (y = 0; y < height; ++y)
+    {
+        convert_row (src, dest, width);
+        src += rowstride;
+        dest += width * 4;
+    }
+}
+
+void
+sn_pixmap_convert (const guint8       *src,
+                   gint                width,
+                   gint                height,
+                   gint                rowstride,
+                   gboolean            has_alpha,
+                   guint8             *dest)
+{
+    sn_pixmap_convert_with_impl (sn_pixmap_get_impl (), src, width, height,
+            rowstride, has_alpha, dest);
+}
+
+/* returns a floating (iiay) for @pixbuf, as used in pixmap properties */
+GVariant *
+sn_pixmap_new_from_pixbuf (GdkPixbuf *pixbuf)
+{
+    gint width, height;
+    gsize len;
+    guint8 *data;
+
+    g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+    g_return_val_if_fail (gdk_pixbuf_get_bits_per_sample (pixbuf) == 8, NULL);
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    len = (gsize) width * (gsize) height * 4;
+
+    data = g_malloc (len);
+    sn_pixmap_convert (gdk_pixbuf_read_pixels (pixbuf),
+            width, height,
+            gdk_pixbuf_get_rowstride (pixbuf),
+            gdk_pixbuf_get_has_alpha (pixbuf),
+            data);
+
+    return g_variant_new ("(ii@ay)", width, height,
+            g_variant_new_from_data (G_VARIANT_TYPE ("ay"), data, len, TRUE,
+                g_free, data));
+}
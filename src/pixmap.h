@@ -0,0 +1,60 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * pixmap.h
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef __PIXMAP_H__
+#define __PIXMAP_H__
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    SN_PIXMAP_IMPL_SCALAR = 0,
+    SN_PIXMAP_IMPL_SSE2,
+    SN_PIXMAP_IMPL_AVX2,
+    SN_PIXMAP_IMPL_NEON,
+    _NB_SN_PIXMAP_IMPLS
+} SnPixmapImpl;
+
+const gchar *   sn_pixmap_impl_name         (SnPixmapImpl        impl);
+gboolean        sn_pixmap_impl_available    (SnPixmapImpl        impl);
+SnPixmapImpl    sn_pixmap_get_impl          (void);
+void            sn_pixmap_convert_with_impl (SnPixmapImpl        impl,
+                                             const guint8       *src,
+                                             gint                width,
+                                             gint                height,
+                                             gint                rowstride,
+                                             gboolean            has_alpha,
+                                             guint8             *dest);
+void            sn_pixmap_convert           (const guint8       *src,
+                                             gint                width,
+                                             gint                height,
+                                             gint                rowstride,
+                                             gboolean            has_alpha,
+                                             guint8             *dest);
+GVariant *      sn_pixmap_new_from_pixbuf   (GdkPixbuf          *pixbuf);
+
+G_END_DECLS
+
+#endif /* __PIXMAP_H__ */
@@ -0,0 +1,70 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * private.h
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef __PRIVATE_H__
+#define __PRIVATE_H__
+
+#include "statusnotifier.h"
+
+G_BEGIN_DECLS
+
+/* Used between StatusNotifierItem and StatusNotifierManager */
+
+/* statusnotifier-manager.c */
+void    _status_notifier_manager_add_item           (StatusNotifierManager  *manager,
+                                                     StatusNotifierItem     *sn);
+void    _status_notifier_manager_remove_item        (StatusNotifierManager  *manager,
+                                                     StatusNotifierItem     *sn);
+void    _status_notifier_manager_register_item      (StatusNotifierManager  *manager,
+                                                     StatusNotifierItem     *sn);
+gboolean _status_notifier_manager_get_export_subtree (StatusNotifierManager *manager);
+gchar * _status_notifier_manager_export_item        (StatusNotifierManager  *manager,
+                                                     StatusNotifierItem     *sn,
+                                                     GDBusConnection        *conn,
+                                                     GError                **error);
+void    _status_notifier_manager_unexport_item      (StatusNotifierManager  *manager,
+                                                     StatusNotifierItem     *sn);
+
+/* statusnotifier.c */
+GDBusInterfaceInfo *
+        _status_notifier_get_watcher_interface_info (void);
+GDBusInterfaceInfo *
+        _status_notifier_get_item_interface_info    (void);
+const GDBusInterfaceVTable *
+        _status_notifier_item_get_interface_vtable  (void);
+GDBusInterfaceInfo *
+        _status_notifier_get_debug_interface_info   (void);
+const GDBusInterfaceVTable *
+        _status_notifier_item_get_debug_vtable      (StatusNotifierItem     *sn);
+GDBusInterfaceInfo *
+        _status_notifier_get_menu_interface_info    (void);
+void    _status_notifier_item_watcher_appeared      (StatusNotifierItem     *sn,
+                                                     GDBusProxy             *proxy,
+                                                     gboolean                host_registered);
+void    _status_notifier_item_watcher_failed        (StatusNotifierItem     *sn,
+                                                     const GError           *error);
+void    _status_notifier_item_watcher_vanished      (StatusNotifierItem     *sn);
+void    _status_notifier_item_host_registered       (StatusNotifierItem     *sn);
+
+G_END_DECLS
+
+#endif /* __PRIVATE_H__ */
@@ -0,0 +1,762 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * statusnotifier-manager.c
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#include "config.h"
+
+#include "statusnotifier.h"
+#include "interfaces.h"
+#include "private.h"
+
+#define _UNUSED_                __attribute__ ((unused))
+
+/**
+ * SECTION:statusnotifier-manager
+ * @Short_description: Shares the StatusNotifierWatcher between items
+ *
+ * Each #StatusNotifierItem watches the StatusNotifierWatcher on the session
+ * bus, and creates its own proxy for it (loading its properties and
+ * subscribing to its signals) when registering. That's fine for the common
+ * case of an application with one item, but an application showing many
+ * items would multiply all of it.
+ *
+ * A #StatusNotifierManager does it once for all items using it: there is a
+ * single watch on the watcher's name, a single proxy and a single connection,
+ * and it lets all its items know when the watcher appears or vanishes, or
+ * when a host registers.
+ *
+ * To use it, simply specify #StatusNotifierItem:manager when creating your
+ * items:
+ * <programlisting>
+ * manager = status_notifier_manager_new ();
+ * sn = (StatusNotifierItem *) g_object_new (STATUS_NOTIFIER_TYPE_ITEM,
+ *      "id",                       "app-account1",
+ *      "manager",                  manager,
+ *      "main-icon-name",           "app-icon",
+ *      NULL);
+ * </programlisting>
+ *
+ * Items keep a reference on their manager, so you can unref it once all items
+ * have been created. Items are then registered as usual, using
+ * status_notifier_item_register(), and will work exactly the same.
+ *
+ * Additionally, with #StatusNotifierManager:export-subtree all items are
+ * exported on the shared connection under a single object subtree (as
+ * /StatusNotifierItem/1, /StatusNotifierItem/2, etc) instead of each owning a
+ * name on the bus, so registering another item only takes a call to the
+ * watcher.
+ */
+
+enum
+{
+    PROP_0,
+
+    PROP_EXPORT_SUBTREE,
+    PROP_CONNECTION,
+    PROP_WATCHER_PRESENT,
+    PROP_HOST_REGISTERED,
+
+    NB_PROPS
+};
+
+/* what we know about the watcher */
+typedef enum
+{
+    WATCHER_UNKNOWN = 0,    /* not watched yet, or waiting for the proxy */
+    WATCHER_PRESENT,
+    WATCHER_ABSENT
+} WatcherState;
+
+struct _StatusNotifierManagerPrivate
+{
+    /* all items using the manager (not referenced) */
+    GList *items;
+
+    WatcherState watcher;
+    gboolean host_registered;
+    guint watch_id;
+    GCancellable *cancellable;
+    GDBusConnection *conn;
+    GDBusProxy *proxy;
+    gulong proxy_sid;
+
+    gboolean export_subtree;
+    guint subtree_id;
+    /* exported items, node name (e.g. "1") -> StatusNotifierItem */
+    GHashTable *exported;
+    guint last_node;
+};
+
+static GParamSpec *status_notifier_manager_props[NB_PROPS] = { NULL, };
+
+#define notify(mgr,prop) \
+    g_object_notify_by_pspec ((GObject *) mgr, status_notifier_manager_props[prop])
+
+static void     status_notifier_manager_set_property    (GObject            *object,
+                                                         guint               prop_id,
+                                                         const GValue       *value,
+                                                         GParamSpec         *pspec);
+static void     status_notifier_manager_get_property    (GObject            *object,
+                                                         guint               prop_id,
+                                                         GValue             *value,
+                                                         GParamSpec         *pspec);
+static void     status_notifier_manager_dispose         (GObject            *object);
+static void     status_notifier_manager_finalize        (GObject            *object);
+
+G_DEFINE_TYPE_WITH_CODE(StatusNotifierManager, status_notifier_manager, G_TYPE_OBJECT,
+                        G_ADD_PRIVATE(StatusNotifierManager));
+
+#define STATUS_NOTIFIER_MANAGER_GET_PRIVATE(object) \
+    (StatusNotifierManagerPrivate *) status_notifier_manager_get_instance_private((StatusNotifierManager*)object)
+
+static void
+status_notifier_manager_class_init (StatusNotifierManagerClass *klass)
+{
+    GObjectClass *o_class;
+
+    o_class = G_OBJECT_CLASS (klass);
+    o_class->set_property   = status_notifier_manager_set_property;
+    o_class->get_property   = status_notifier_manager_get_property;
+    o_class->dispose        = status_notifier_manager_dispose;
+    o_class->finalize       = status_notifier_manager_finalize;
+
+    /**
+     * StatusNotifierManager:export-subtree:
+     *
+     * When %TRUE, items don't each own a name on the bus and get exported at
+     * /StatusNotifierItem, but are all exported under an object subtree
+     * registered once on the shared connection, each at its own path (e.g.
+     * /StatusNotifierItem/3), and registered on the watcher using that path.
+     *
+     * This makes registering many items much cheaper, as it only requires one
+     * call to the watcher per item, without any name acquisition.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_manager_props[PROP_EXPORT_SUBTREE] =
+        g_param_spec_boolean ("export-subtree", "export-subtree",
+                "Whether to export all items under one object subtree",
+                FALSE,
+                G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    /**
+     * StatusNotifierManager:connection:
+     *
+     * The #GDBusConnection shared by all items, or %NULL if no
+     * StatusNotifierWatcher was found (yet).
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_manager_props[PROP_CONNECTION] =
+        g_param_spec_object ("connection", "connection",
+                "DBus connection shared by all items",
+                G_TYPE_DBUS_CONNECTION,
+                G_PARAM_READABLE);
+
+    /**
+     * StatusNotifierManager:watcher-present:
+     *
+     * Whether the StatusNotifierWatcher is present on the session bus. Note
+     * that this is only known once an item was registered.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_manager_props[PROP_WATCHER_PRESENT] =
+        g_param_spec_boolean ("watcher-present", "watcher-present",
+                "Whether the StatusNotifierWatcher is present",
+                FALSE,
+                G_PARAM_READABLE);
+
+    /**
+     * StatusNotifierManager:host-registered:
+     *
+     * Whether at least one StatusNotifierHost is registered on the
+     * StatusNotifierWatcher.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_manager_props[PROP_HOST_REGISTERED] =
+        g_param_spec_boolean ("host-registered", "host-registered",
+                "Whether a StatusNotifierHost is registered",
+                FALSE,
+                G_PARAM_READABLE);
+
+    g_object_class_install_properties (o_class, NB_PROPS, status_notifier_manager_props);
+}
+
+static void
+status_notifier_manager_init (StatusNotifierManager *manager)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+
+    priv->exported = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static void
+status_notifier_manager_set_property (GObject            *object,
+                                      guint               prop_id,
+                                      const GValue       *value,
+                                      GParamSpec         *pspec)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(object);
+
+    switch (prop_id)
+    {
+        case PROP_EXPORT_SUBTREE:   /* G_PARAM_CONSTRUCT_ONLY */
+            priv->export_subtree = g_value_get_boolean (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void
+status_notifier_manager_get_property (GObject            *object,
+                                      guint               prop_id,
+                                      GValue             *value,
+                                      GParamSpec         *pspec)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(object);
+
+    switch (prop_id)
+    {
+        case PROP_EXPORT_SUBTREE:
+            g_value_set_boolean (value, priv->export_subtree);
+            break;
+        case PROP_CONNECTION:
+            g_value_set_object (value, priv->conn);
+            break;
+        case PROP_WATCHER_PRESENT:
+            g_value_set_boolean (value, priv->watcher == WATCHER_PRESENT);
+            break;
+        case PROP_HOST_REGISTERED:
+            g_value_set_boolean (value, priv->host_registered);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+}
+
+static void
+free_proxy (StatusNotifierManager *manager)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+
+    if (priv->cancellable)
+    {
+        g_cancellable_cancel (priv->cancellable);
+        g_object_unref (priv->cancellable);
+        priv->cancellable = NULL;
+    }
+    if (priv->proxy_sid > 0)
+    {
+        g_signal_handler_disconnect (priv->proxy, priv->proxy_sid);
+        priv->proxy_sid = 0;
+    }
+    if (priv->proxy)
+    {
+        g_object_unref (priv->proxy);
+        priv->proxy = NULL;
+    }
+}
+
+static void
+status_notifier_manager_dispose (GObject *object)
+{
+    StatusNotifierManager *manager = (StatusNotifierManager *) object;
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(object);
+
+    if (priv->watch_id > 0)
+    {
+        g_bus_unwatch_name (priv->watch_id);
+        priv->watch_id = 0;
+    }
+    free_proxy (manager);
+    if (priv->subtree_id > 0)
+    {
+        g_dbus_connection_unregister_subtree (priv->conn, priv->subtree_id);
+        priv->subtree_id = 0;
+    }
+    if (priv->conn)
+    {
+        g_object_unref (priv->conn);
+        priv->conn = NULL;
+    }
+
+    G_OBJECT_CLASS (status_notifier_manager_parent_class)->dispose (object);
+}
+
+static void
+status_notifier_manager_finalize (GObject *object)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(object);
+
+    /* items hold a reference on us, so there shouldn't be any left */
+    g_list_free (priv->items);
+    g_hash_table_unref (priv->exported);
+
+    G_OBJECT_CLASS (status_notifier_manager_parent_class)->finalize (object);
+}
+
+/* returns a copy of the list of items, each with a reference, since any of them
+ * could be removed (e.g. unref-d from a handler of
+ * StatusNotifierItem::registration-failed) while we go through it */
+static GList *
+get_items (StatusNotifierManager *manager)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    GList *items = NULL;
+    GList *l;
+
+    for (l = priv->items; l; l = l->next)
+        items = g_list_prepend (items, g_object_ref (l->data));
+    return g_list_reverse (items);
+}
+
+static void
+watcher_signal (GDBusProxy              *proxy _UNUSED_,
+                const gchar             *sender _UNUSED_,
+                const gchar             *signal,
+                GVariant                *params _UNUSED_,
+                StatusNotifierManager   *manager)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    GList *items, *l;
+
+    if (!g_strcmp0 (signal, "StatusNotifierHostUnregistered"))
+    {
+        /* only informational, there might still be other hosts */
+        return;
+    }
+    else if (g_strcmp0 (signal, "StatusNotifierHostRegistered"))
+        return;
+
+    if (!priv->host_registered)
+    {
+        priv->host_registered = TRUE;
+        notify (manager, PROP_HOST_REGISTERED);
+    }
+
+    items = get_items (manager);
+    for (l = items; l; l = l->next)
+        _status_notifier_item_host_registered (l->data);
+    g_list_free_full (items, g_object_unref);
+}
+
+static void
+proxy_cb (GObject *sce _UNUSED_, GAsyncResult *result, gpointer data)
+{
+    GError *err = NULL;
+    StatusNotifierManager *manager;
+    StatusNotifierManagerPrivate *priv;
+    GDBusProxy *proxy;
+    GVariant *variant;
+    GList *items, *l;
+
+    proxy = g_dbus_proxy_new_finish (result, &err);
+    if (!proxy && g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        /* manager might be gone */
+        g_error_free (err);
+        return;
+    }
+
+    manager = data;
+    priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    g_object_unref (priv->cancellable);
+    priv->cancellable = NULL;
+
+    items = get_items (manager);
+    if (!proxy)
+    {
+        priv->watcher = WATCHER_ABSENT;
+        for (l = items; l; l = l->next)
+            _status_notifier_item_watcher_failed (l->data, err);
+        g_list_free_full (items, g_object_unref);
+        g_error_free (err);
+        return;
+    }
+
+    priv->proxy = proxy;
+    priv->proxy_sid = g_signal_connect (priv->proxy, "g-signal",
+            (GCallback) watcher_signal, manager);
+    priv->watcher = WATCHER_PRESENT;
+
+    variant = g_dbus_proxy_get_cached_property (priv->proxy,
+            "IsStatusNotifierHostRegistered");
+    priv->host_registered = variant && g_variant_get_boolean (variant);
+    if (variant)
+        g_variant_unref (variant);
+
+    g_object_freeze_notify ((GObject *) manager);
+    notify (manager, PROP_WATCHER_PRESENT);
+    notify (manager, PROP_HOST_REGISTERED);
+    g_object_thaw_notify ((GObject *) manager);
+
+    for (l = items; l; l = l->next)
+        _status_notifier_item_watcher_appeared (l->data, priv->proxy,
+                priv->host_registered);
+    g_list_free_full (items, g_object_unref);
+}
+
+static void
+watcher_appeared (GDBusConnection   *conn,
+                  const gchar       *name _UNUSED_,
+                  const gchar       *owner _UNUSED_,
+                  gpointer           data)
+{
+    StatusNotifierManager *manager = data;
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+
+    free_proxy (manager);
+    priv->watcher = WATCHER_UNKNOWN;
+    if (priv->conn != conn)
+    {
+        if (priv->subtree_id > 0)
+        {
+            /* items were unexported when the watcher vanished */
+            g_dbus_connection_unregister_subtree (priv->conn, priv->subtree_id);
+            priv->subtree_id = 0;
+        }
+        if (priv->conn)
+            g_object_unref (priv->conn);
+        priv->conn = g_object_ref (conn);
+        notify (manager, PROP_CONNECTION);
+    }
+
+    priv->cancellable = g_cancellable_new ();
+    g_dbus_proxy_new (priv->conn,
+            G_DBUS_PROXY_FLAGS_NONE,
+            _status_notifier_get_watcher_interface_info (),
+            WATCHER_NAME,
+            WATCHER_OBJECT,
+            WATCHER_INTERFACE,
+            priv->cancellable,
+            proxy_cb,
+            manager);
+}
+
+static void
+watcher_vanished (GDBusConnection   *conn _UNUSED_,
+                  const gchar       *name _UNUSED_,
+                  gpointer           data)
+{
+    StatusNotifierManager *manager = data;
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    gboolean was_present;
+    GList *items, *l;
+
+    was_present = priv->watcher == WATCHER_PRESENT;
+    free_proxy (manager);
+    priv->watcher = WATCHER_ABSENT;
+
+    g_object_freeze_notify ((GObject *) manager);
+    if (was_present)
+        notify (manager, PROP_WATCHER_PRESENT);
+    if (priv->host_registered)
+    {
+        priv->host_registered = FALSE;
+        notify (manager, PROP_HOST_REGISTERED);
+    }
+    g_object_thaw_notify ((GObject *) manager);
+
+    items = get_items (manager);
+    for (l = items; l; l = l->next)
+        _status_notifier_item_watcher_vanished (l->data);
+    g_list_free_full (items, g_object_unref);
+}
+
+void
+_status_notifier_manager_add_item (StatusNotifierManager  *manager,
+                                   StatusNotifierItem     *sn)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    priv->items = g_list_prepend (priv->items, sn);
+}
+
+void
+_status_notifier_manager_remove_item (StatusNotifierManager  *manager,
+                                      StatusNotifierItem     *sn)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    priv->items = g_list_remove (priv->items, sn);
+}
+
+static gchar **
+subtree_enumerate (GDBusConnection  *conn _UNUSED_,
+                   const gchar      *sender _UNUSED_,
+                   const gchar      *object _UNUSED_,
+                   gpointer          data)
+{
+    StatusNotifierManager *manager = data;
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    GHashTableIter iter;
+    gpointer node;
+    gchar **nodes;
+    guint i = 0;
+
+    nodes = g_new (gchar *, g_hash_table_size (priv->exported) + 1);
+    g_hash_table_iter_init (&iter, priv->exported);
+    while (g_hash_table_iter_next (&iter, &node, NULL))
+        nodes[i++] = g_strdup (node);
+    nodes[i] = NULL;
+
+    return nodes;
+}
+
+static GDBusInterfaceInfo **
+subtree_introspect (GDBusConnection  *conn _UNUSED_,
+                    const gchar      *sender _UNUSED_,
+                    const gchar      *object _UNUSED_,
+                    const gchar      *node,
+                    gpointer          data)
+{
+    StatusNotifierManager *manager = data;
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    GDBusInterfaceInfo **infos;
+    StatusNotifierItem *sn;
+    guint i = 0;
+
+    sn = (node) ? g_hash_table_lookup (priv->exported, node) : NULL;
+    if (!sn)
+        return NULL;
+
+    infos = g_new (GDBusInterfaceInfo *, 3);
+    infos[i++] = g_dbus_interface_info_ref (_status_notifier_get_item_interface_info ());
+    if (_status_notifier_item_get_debug_vtable (sn))
+        infos[i++] = g_dbus_interface_info_ref (_status_notifier_get_debug_interface_info ());
+    infos[i] = NULL;
+
+    return infos;
+}
+
+static const GDBusInterfaceVTable *
+subtree_dispatch (GDBusConnection  *conn _UNUSED_,
+                  const gchar      *sender _UNUSED_,
+                  const gchar      *object _UNUSED_,
+                  const gchar      *interface,
+                  const gchar      *node,
+                  gpointer         *out_data,
+                  gpointer          data)
+{
+    StatusNotifierManager *manager = data;
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    StatusNotifierItem *sn;
+
+    sn = (node) ? g_hash_table_lookup (priv->exported, node) : NULL;
+    if (!sn)
+        return NULL;
+
+    *out_data = sn;
+    if (!g_strcmp0 (interface, DEBUG_INTERFACE))
+        return _status_notifier_item_get_debug_vtable (sn);
+    return _status_notifier_item_get_interface_vtable ();
+}
+
+static const GDBusSubtreeVTable subtree_vtable = {
+    .enumerate  = subtree_enumerate,
+    .introspect = subtree_introspect,
+    .dispatch   = subtree_dispatch
+};
+
+gboolean
+_status_notifier_manager_get_export_subtree (StatusNotifierManager  *manager)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    return priv->export_subtree;
+}
+
+/* exports @sn in our subtree on @conn, returning its object path */
+gchar *
+_status_notifier_manager_export_item (StatusNotifierManager  *manager,
+                                      StatusNotifierItem     *sn,
+                                      GDBusConnection        *conn,
+                                      GError                **error)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    gchar *node;
+
+    g_return_val_if_fail (conn == priv->conn, NULL);
+
+    if (priv->subtree_id == 0)
+    {
+        priv->subtree_id = g_dbus_connection_register_subtree (conn,
+                ITEM_OBJECT,
+                &subtree_vtable,
+                G_DBUS_SUBTREE_FLAGS_NONE,
+                manager, NULL,
+                error);
+        if (priv->subtree_id == 0)
+            return NULL;
+    }
+
+    node = g_strdup_printf ("%u", ++priv->last_node);
+    g_hash_table_insert (priv->exported, node, sn);
+
+    return g_strdup_printf ("%s/%s", ITEM_OBJECT, node);
+}
+
+static gboolean
+is_item (gpointer key _UNUSED_, gpointer value, gpointer data)
+{
+    return value == data;
+}
+
+void
+_status_notifier_manager_unexport_item (StatusNotifierManager  *manager,
+                                        StatusNotifierItem     *sn)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    g_hash_table_foreach_remove (priv->exported, is_item, sn);
+}
+
+/* @sn starts registering: it either gets the watcher right away if we have it,
+ * or will when we do */
+void
+_status_notifier_manager_register_item (StatusNotifierManager  *manager,
+                                        StatusNotifierItem     *sn)
+{
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+
+    if (priv->watch_id == 0)
+    {
+        priv->watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION,
+                WATCHER_NAME,
+                G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+                watcher_appeared,
+                watcher_vanished,
+                manager, NULL);
+        return;
+    }
+
+    switch (priv->watcher)
+    {
+        case WATCHER_PRESENT:
+            _status_notifier_item_watcher_appeared (sn, priv->proxy,
+                    priv->host_registered);
+            break;
+        case WATCHER_ABSENT:
+            _status_notifier_item_watcher_vanished (sn);
+            break;
+        case WATCHER_UNKNOWN:
+            /* we'll let it know */
+            break;
+    }
+}
+
+/**
+ * status_notifier_manager_new:
+ *
+ * Creates a new #StatusNotifierManager, to be used as
+ * #StatusNotifierItem:manager by items so they share the watching of and
+ * connection to the StatusNotifierWatcher.
+ *
+ * Returns: (transfer full): A new #StatusNotifierManager
+ *
+ * Since: 1.1.0
+ */
+StatusNotifierManager *
+status_notifier_manager_new (void)
+{
+    return (StatusNotifierManager *) g_object_new (STATUS_NOTIFIER_TYPE_MANAGER, NULL);
+}
+
+/**
+ * status_notifier_manager_get_export_subtree:
+ * @manager: A #StatusNotifierManager
+ *
+ * Returns whether items are exported under one object subtree. See
+ * #StatusNotifierManager:export-subtree
+ *
+ * Returns: Whether items are exported under one object subtree
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_manager_get_export_subtree (StatusNotifierManager   *manager)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_MANAGER (manager), FALSE);
+
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    return priv->export_subtree;
+}
+
+/**
+ * status_notifier_manager_get_connection:
+ * @manager: A #StatusNotifierManager
+ *
+ * Returns the #GDBusConnection shared by all items of @manager. See
+ * #StatusNotifierManager:connection
+ *
+ * Returns: (transfer none): The #GDBusConnection, or %NULL
+ *
+ * Since: 1.1.0
+ */
+GDBusConnection *
+status_notifier_manager_get_connection (StatusNotifierManager   *manager)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_MANAGER (manager), NULL);
+
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    return priv->conn;
+}
+
+/**
+ * status_notifier_manager_get_watcher_present:
+ * @manager: A #StatusNotifierManager
+ *
+ * Returns whether the StatusNotifierWatcher is present. See
+ * #StatusNotifierManager:watcher-present
+ *
+ * Returns: Whether the StatusNotifierWatcher is present
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_manager_get_watcher_present (StatusNotifierManager   *manager)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_MANAGER (manager), FALSE);
+
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    return priv->watcher == WATCHER_PRESENT;
+}
+
+/**
+ * status_notifier_manager_get_host_registered:
+ * @manager: A #StatusNotifierManager
+ *
+ * Returns whether a StatusNotifierHost is registered on the
+ * StatusNotifierWatcher. See #StatusNotifierManager:host-registered
+ *
+ * Returns: Whether a StatusNotifierHost is registered
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_manager_get_host_registered (StatusNotifierManager   *manager)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_MANAGER (manager), FALSE);
+
+    StatusNotifierManagerPrivate *priv = STATUS_NOTIFIER_MANAGER_GET_PRIVATE(manager);
+    return priv->host_registered;
+}
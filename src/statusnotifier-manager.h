@@ -0,0 +1,73 @@
+/*
+ * statusnotifier - Copyright (C) 2014-2017 Olivier Brunel
+ *
+ * statusnotifier-manager.h
+ * Copyright (C) 2014-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of statusnotifier.
+ *
+ * statusnotifier is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * statusnotifier is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * statusnotifier. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef __STATUS_NOTIFIER_MANAGER_H__
+#define __STATUS_NOTIFIER_MANAGER_H__
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _StatusNotifierManager           StatusNotifierManager;
+typedef struct _StatusNotifierManagerPrivate    StatusNotifierManagerPrivate;
+typedef struct _StatusNotifierManagerClass      StatusNotifierManagerClass;
+
+GType status_notifier_manager_get_type (void) G_GNUC_CONST;
+
+#define STATUS_NOTIFIER_TYPE_MANAGER            (status_notifier_manager_get_type ())
+#define STATUS_NOTIFIER_MANAGER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), STATUS_NOTIFIER_TYPE_MANAGER, StatusNotifierManager))
+#define STATUS_NOTIFIER_MANAGER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), STATUS_NOTIFIER_TYPE_MANAGER, StatusNotifierManagerClass))
+#define STATUS_NOTIFIER_IS_MANAGER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), STATUS_NOTIFIER_TYPE_MANAGER))
+#define STATUS_NOTIFIER_IS_MANAGER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), STATUS_NOTIFIER_TYPE_MANAGER))
+#define STATUS_NOTIFIER_MANAGER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), STATUS_NOTIFIER_TYPE_MANAGER, StatusNotifierManagerClass))
+
+struct _StatusNotifierManager
+{
+    /*< private >*/
+    GObject parent;
+    StatusNotifierManagerPrivate *priv;
+};
+
+/**
+ * StatusNotifierManagerClass:
+ * @parent_class: Parent class
+ */
+struct _StatusNotifierManagerClass
+{
+    GObjectClass parent_class;
+};
+
+StatusNotifierManager * status_notifier_manager_new (void);
+gboolean                status_notifier_manager_get_export_subtree (
+                                            StatusNotifierManager   *manager);
+GDBusConnection *       status_notifier_manager_get_connection (
+                                            StatusNotifierManager   *manager);
+gboolean                status_notifier_manager_get_watcher_present (
+                                            StatusNotifierManager   *manager);
+gboolean                status_notifier_manager_get_host_registered (
+                                            StatusNotifierManager   *manager);
+
+G_END_DECLS
+
+#endif /* __STATUS_NOTIFIER_MANAGER_H__ */
@@ -23,11 +23,14 @@
 #include "config.h"
 
 #include <unistd.h>
-#include <gdk/gdk.h>
+#include <string.h>
 #include "statusnotifier.h"
 #include "enums.h"
 #include "interfaces.h"
 #include "closures.h"
+#include "pixmap.h"
+#include "menu.h"
+#include "private.h"
 
 #if USE_DBUSMENU
 #include <gtk/gtk.h>
@@ -78,6 +81,15 @@
  * signals (such as #StatusNotifierItem::context-menu) which will be emitted
  * when the corresponding DBus method was called.
  *
+ * A #StatusNotifierItem belongs to the thread it was created in, and its
+ * thread-default #GMainContext at the time. The setters of the icons, title,
+ * status, window id and tooltip (as well as status_notifier_item_begin_update()
+ * and status_notifier_item_commit_update(), and the tooltip freezing
+ * functions) can however be called from any thread: changes are then queued
+ * and applied from that context, with consecutive changes of the same thing
+ * only applied once. Everything else, including getters, must be used from the
+ * item's thread/context only.
+ *
  * For reference, the specifications can be found at
  * https://freedesktop.org/wiki/Specifications/StatusNotifierItem/
  *
@@ -109,9 +121,20 @@ enum
     PROP_ITEM_IS_MENU,
     PROP_MENU,
     PROP_WINDOW_ID,
+    PROP_PIXMAP_SIZES,
+    PROP_RASTER_CACHE_SIZE,
+    PROP_COALESCE_SIGNALS,
+    PROP_COMPARE_PIXBUFS,
+    PROP_EMIT_PROPERTIES_CHANGED,
+    PROP_PROPERTIES_CHANGED_MAX_SIZE,
 
     PROP_STATE,
     PROP_REGISTER_NAME_ON_BUS,
+    PROP_MANAGER,
+    PROP_FAST_START,
+    PROP_EXPORT_STATS,
+    PROP_SERVICE_THREAD,
+    PROP_REPLY_FIRST,
 
     NB_PROPS
 };
@@ -129,6 +152,82 @@ static guint prop_pixbuf_from_icon[_NB_STATUS_NOTIFIER_ICONS] = {
     PROP_TOOLTIP_ICON_PIXBUF
 };
 
+/* DBus signals of the item */
+enum
+{
+    DBUS_SIGNAL_NEW_TITLE,
+    DBUS_SIGNAL_NEW_ICON,
+    DBUS_SIGNAL_NEW_ATTENTION_ICON,
+    DBUS_SIGNAL_NEW_OVERLAY_ICON,
+    DBUS_SIGNAL_NEW_TOOLTIP,
+    DBUS_SIGNAL_NEW_STATUS,
+    NB_DBUS_SIGNALS
+};
+
+static const gchar * const dbus_signal_names[NB_DBUS_SIGNALS] = {
+    "NewTitle",
+    "NewIcon",
+    "NewAttentionIcon",
+    "NewOverlayIcon",
+    "NewToolTip",
+    "NewStatus"
+};
+
+/* DBus properties of the item, see dbus_props */
+enum
+{
+    DBUS_PROP_ID,
+    DBUS_PROP_CATEGORY,
+    DBUS_PROP_TITLE,
+    DBUS_PROP_STATUS,
+    DBUS_PROP_WINDOW_ID,
+    DBUS_PROP_ICON_NAME,
+    DBUS_PROP_ICON_PIXMAP,
+    DBUS_PROP_OVERLAY_ICON_NAME,
+    DBUS_PROP_OVERLAY_ICON_PIXMAP,
+    DBUS_PROP_ATTENTION_ICON_NAME,
+    DBUS_PROP_ATTENTION_ICON_PIXMAP,
+    DBUS_PROP_ATTENTION_MOVIE_NAME,
+    DBUS_PROP_TOOLTIP,
+    DBUS_PROP_ITEM_IS_MENU,
+    DBUS_PROP_MENU,
+    NB_DBUS_PROPS
+};
+
+/* DBus methods of the item, see dbus_methods */
+enum
+{
+    DBUS_METHOD_CONTEXT_MENU,
+    DBUS_METHOD_ACTIVATE,
+    DBUS_METHOD_SECONDARY_ACTIVATE,
+    DBUS_METHOD_SCROLL,
+    NB_DBUS_METHODS
+};
+
+/* DBus interfaces we use, see get_interface_info() */
+enum
+{
+    INTERFACE_ITEM,
+    INTERFACE_WATCHER,
+    INTERFACE_DEBUG,
+    INTERFACE_MENU,
+    NB_INTERFACES
+};
+
+/* steps of the registration, see StatusNotifierRegistrationTimings */
+enum
+{
+    TIMING_REGISTER,
+    TIMING_WATCHER_APPEARED,
+    TIMING_WATCHER_READY,
+    TIMING_REGISTERING,
+    TIMING_OBJECT_EXPORTED,
+    TIMING_NAME_ACQUIRED,
+    TIMING_REGISTERED,
+    TIMING_WATCHER_LOST,
+    NB_TIMINGS
+};
+
 enum
 {
     SIGNAL_REGISTRATION_FAILED,
@@ -139,6 +238,87 @@ enum
     NB_SIGNALS
 };
 
+/* changes made from other threads, see queue_update() */
+enum
+{
+    UPDATE_ICON_NAME,
+    UPDATE_ICON_PIXBUF,
+    UPDATE_ICON_BYTES,
+    UPDATE_ICON_GICON,
+    UPDATE_ATTENTION_MOVIE_NAME,
+    UPDATE_TITLE,
+    UPDATE_STATUS,
+    UPDATE_WINDOW_ID,
+    UPDATE_TOOLTIP,
+    UPDATE_TOOLTIP_WITH_PIXBUF,
+    UPDATE_TOOLTIP_TITLE,
+    UPDATE_TOOLTIP_BODY,
+    UPDATE_ITEM_IS_MENU,
+    /* the following are never coalesced */
+    UPDATE_FREEZE_TOOLTIP,
+    UPDATE_THAW_TOOLTIP,
+    UPDATE_BEGIN,
+    UPDATE_COMMIT
+};
+
+/* see status_notifier_item_set_submenu_provider() */
+typedef struct
+{
+    StatusNotifierSubmenuProvider func;
+    gpointer data;
+    GDestroyNotify destroy;
+    /* whether the submenu was filled, and still valid */
+    gboolean filled;
+} Provider;
+
+/* an icon set via GIcon, rendered at a given size */
+typedef struct
+{
+    StatusNotifierIcon icon;
+    /* -1 for its native size */
+    gint32 size;
+    /* (iiay) */
+    GVariant *entry;
+} Raster;
+
+typedef struct _Update Update;
+struct _Update
+{
+    Update *next;
+    guint op;
+    StatusNotifierIcon icon;
+    guint value;
+    GdkPixbuf *pixbuf;
+    GBytes *bytes;
+    GIcon *gicon;
+    gchar *str[3];
+};
+
+static void free_update (Update *update);
+static void free_raster (Raster *raster);
+static void push_update (StatusNotifierItem *sn, Update *update);
+
+/* what the DBus service thread works with, see
+ * StatusNotifierItem:service-thread. Forwarded method calls can outlive the
+ * thread, hence the refcount, and the item can be gone when they are run */
+typedef struct
+{
+    gint ref_count;
+    GWeakRef item;
+    /* the item's context, where method calls are forwarded to */
+    GMainContext *item_context;
+    GMainContext *context;
+    GMainLoop *loop;
+    GThread *thread;
+    /* values of DBus properties, published from the item's context */
+    GMutex lock;
+    GVariant *values[NB_DBUS_PROPS];
+    GVariant *snapshot;
+    /* statistics of what was served from the thread */
+    guint stats_get[NB_DBUS_PROPS];
+    guint stats_get_all;
+} Service;
+
 struct _StatusNotifierItemPrivate
 {
     gchar *id;
@@ -151,16 +331,57 @@ struct _StatusNotifierItemPrivate
             gchar *icon_name;
             GdkPixbuf *pixbuf;
         };
+        /* encoded image (see status_notifier_item_set_from_bytes()); pixbuf
+         * is then only decoded from it when needed, and may be NULL */
+        GBytes *data;
+        /* loadable icon (see status_notifier_item_set_from_gicon()), rendered
+         * at each pixmap size via the raster cache; pixbuf is then only its
+         * native size version, loaded when asked for */
+        GIcon *gicon;
+        /* serialized a(iiay) for the DBus pixmap property, built on demand */
+        GVariant *pixmap;
     } icon[_NB_STATUS_NOTIFIER_ICONS];
     gchar *attention_movie_name;
     gchar *tooltip_title;
     gchar *tooltip_body;
     guint32 window_id;
     gboolean item_is_menu;
+    /* sizes to scale pixbuf icons to, sorted; NULL when using native size */
+    GArray *pixmap_sizes;
+    /* renders (Raster) of GIcon icons, most recently used first */
+    GQueue raster_cache;
+    gsize raster_cache_bytes;
+    guint raster_cache_size;
 
     guint tooltip_freeze;
+    /* whether the tooltip changed while frozen */
+    gboolean tooltip_changed;
+    guint update_freeze;
+
+    gboolean coalesce_signals;
+    gboolean compare_pixbufs;
+    gboolean emit_properties_changed;
+    guint properties_changed_max_size;
+    /* DBus signals (bitmask of 1 << DBUS_SIGNAL_*) waiting to be emitted */
+    guint dbus_pending;
+    GSource *dbus_flush_source;
+    /* values of DBus properties, kept until invalidated (bitmask of
+     * 1 << DBUS_PROP_* in dbus_dirty), and a{sv} of them all for GetAll */
+    GVariant *dbus_values[NB_DBUS_PROPS];
+    guint dbus_dirty;
+    GVariant *dbus_snapshot;
 
     StatusNotifierState state;
+    StatusNotifierManager *manager;
+    gboolean fast_start;
+    /* with fast_start, the name acquired while waiting for the watcher, or
+     * whether the watcher is ready while waiting for the name */
+    gchar *fast_name;
+    gboolean fast_watcher_ready;
+    /* whether the name was requested ahead of the watcher, see fast_pending() */
+    gboolean fast_owning;
+    /* when exported in the manager's subtree, else at ITEM_OBJECT */
+    gchar *object_path;
     guint dbus_watch_id;
     gulong dbus_sid;
     guint dbus_owner_id;
@@ -171,15 +392,53 @@ struct _StatusNotifierItemPrivate
     DbusmenuServer *menu_service;
     GObject *menu;
 #endif
+    /* see status_notifier_item_set_menu_model() */
+    SnMenu *menu_model;
+    /* GMenu -> Provider, see status_notifier_item_set_submenu_provider() */
+    GHashTable *providers;
     GDBusConnection *dbus_conn;
     GError *dbus_err;
+    /* what was registered with the watcher, kept while on the bus so we can
+     * register again if the watcher is restarted */
+    gchar *dbus_name;
+    /* monotonic time each step of the registration was reached, or 0 */
+    gint64 timings[NB_TIMINGS];
+
+    /* where the item belongs, see is_owner() */
+    GMainContext *context;
+    GThread *thread;
+    /* stack of changes from other threads, most recent first */
+    Update *updates;
+    gboolean service_thread;
+    Service *service;
+    GSource *service_publish_source;
+    gboolean reply_first;
+
+    /* statistics, see status_notifier_item_get_stats() */
+    gboolean export_stats;
+    guint dbus_debug_id;
+    guint stats_signals[NB_DBUS_SIGNALS];
+    guint stats_properties_changed;
+    guint stats_get[NB_DBUS_PROPS];
+    guint stats_get_all;
+    guint stats_methods[NB_DBUS_METHODS];
+    guint value_cache_hits;
+    guint value_cache_misses;
+    guint64 pixmap_bytes;
+    guint pixmap_cache_hits;
+    guint pixmap_cache_misses;
+    guint raster_cache_hits;
+    guint raster_cache_misses;
 };
 
-static guint uniq_id = 0;
+static gint uniq_id = 0;
 
 static GParamSpec *status_notifier_item_props[NB_PROPS] = { NULL, };
 static guint status_notifier_item_signals[NB_SIGNALS] = { 0, };
 
+#define object_path(priv) \
+    (((priv)->object_path) ? (priv)->object_path : ITEM_OBJECT)
+
 #define notify(sn,prop) \
     g_object_notify_by_pspec ((GObject *) sn, status_notifier_item_props[prop])
 
@@ -192,6 +451,19 @@ static void     status_notifier_item_get_property   (GObject            *object,
                                                      GValue             *value,
                                                      GParamSpec         *pspec);
 static void     status_notifier_item_finalize       (GObject            *object);
+static GVariant *get_icon_pixmap                    (StatusNotifierItem *sn,
+                                                     StatusNotifierIcon  icon);
+static GdkPixbuf *get_icon_pixbuf                   (StatusNotifierItem *sn,
+                                                     StatusNotifierIcon  icon);
+static void     clear_rasters                       (StatusNotifierItem *sn,
+                                                     StatusNotifierIcon  icon);
+static void     trim_raster_cache                   (StatusNotifierItem *sn);
+static void     dbus_emit_properties_changed        (StatusNotifierItem *sn,
+                                                     guint               signals);
+static void     service_publish                     (StatusNotifierItem *sn);
+static gboolean service_publish_cb                  (gpointer            data);
+static void     service_stop                        (StatusNotifierItem *sn);
+static void     export_menu_model                   (StatusNotifierItem *sn);
 
 #if defined(GLIB_VERSION_2_38)
 
@@ -532,6 +804,127 @@ status_notifier_item_class_init (StatusNotifierItemClass *klass)
                 0,
                 G_PARAM_READWRITE);
 
+    /**
+     * StatusNotifierItem:pixmap-sizes:
+     *
+     * When icons are set via #GdkPixbuf, their data is by default sent as-is
+     * to the hosts, leaving it up to them to scale it as needed. If sizes are
+     * set here (as an array of integers), icons will instead be scaled once to
+     * each of those sizes, and all versions will be sent, so hosts can simply
+     * pick the most appropriate one.
+     *
+     * See status_notifier_item_set_pixmap_sizes()
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_PIXMAP_SIZES] =
+        g_param_spec_variant ("pixmap-sizes", "pixmap-sizes",
+                "Sizes icons set via pixbuf are sent as",
+                G_VARIANT_TYPE ("ai"),
+                NULL,
+                G_PARAM_READWRITE);
+
+    /**
+     * StatusNotifierItem:raster-cache-size:
+     *
+     * Icons set via status_notifier_item_set_from_gicon() are rendered at each
+     * pixmap size when needed, and those renders kept in a cache (so e.g.
+     * changing pixmap sizes back and forth, as when moving between screens of
+     * different scales, doesn't require rendering again).
+     *
+     * This is the budget of that cache, in bytes: once exceeded, least
+     * recently used renders are dropped. Renders used in the current pixmap
+     * of an icon are never dropped (that pixmap holds them anyway), but do
+     * count towards the budget, i.e. it only really limits the renders kept
+     * for sizes or icons not currently in use.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_RASTER_CACHE_SIZE] =
+        g_param_spec_uint ("raster-cache-size", "raster-cache-size",
+                "Maximum size of the cache of rendered GIcon icons",
+                0, G_MAXUINT,
+                256 * 1024,
+                G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
+
+    /**
+     * StatusNotifierItem:coalesce-signals:
+     *
+     * When %TRUE (the default) DBus signals about changes (e.g. NewIcon,
+     * NewTitle, etc) aren't emitted right away, but from an idle source, so
+     * that changing multiple properties in a row only results in each signal
+     * being emitted (at most) once, instead of hosts being notified (and
+     * coming back to get the new value) after each change.
+     *
+     * Set to %FALSE to have signals emitted immediately upon each change.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_COALESCE_SIGNALS] =
+        g_param_spec_boolean ("coalesce-signals", "coalesce-signals",
+                "Whether to emit DBus signals once per main loop iteration",
+                TRUE,
+                G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
+
+    /**
+     * StatusNotifierItem:compare-pixbufs:
+     *
+     * Setting an icon to the #GdkPixbuf it is already set to does nothing, but
+     * pixbufs are only compared by pointer. When %TRUE, a different #GdkPixbuf
+     * holding the exact same image (size and pixels) is also considered
+     * unchanged, so no notification nor DBus signal is emitted.
+     *
+     * This costs a comparison of the pixel data on every change, hence is
+     * disabled by default.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_COMPARE_PIXBUFS] =
+        g_param_spec_boolean ("compare-pixbufs", "compare-pixbufs",
+                "Whether to compare pixel data of pixbufs set as icons",
+                FALSE,
+                G_PARAM_READWRITE);
+
+    /**
+     * StatusNotifierItem:emit-properties-changed:
+     *
+     * Per the specification, hosts are only told something changed (e.g. via
+     * DBus signal NewIcon) and then need to get the new value(s), i.e. each
+     * change costs a round-trip.
+     *
+     * When %TRUE, signal PropertiesChanged of the standard interface
+     * org.freedesktop.DBus.Properties is also emitted (along with the regular
+     * signals, so hosts not supporting it are unaffected), including the new
+     * values, so hosts listening to it can update without any round-trip.
+     *
+     * Values larger than #StatusNotifierItem:properties-changed-max-size (e.g.
+     * icon pixmaps) are only listed as invalidated, for hosts to get them only
+     * if/when needed.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_EMIT_PROPERTIES_CHANGED] =
+        g_param_spec_boolean ("emit-properties-changed", "emit-properties-changed",
+                "Whether to emit DBus signal PropertiesChanged with new values",
+                FALSE,
+                G_PARAM_READWRITE);
+
+    /**
+     * StatusNotifierItem:properties-changed-max-size:
+     *
+     * Maximum size (in bytes) of a value to be included in DBus signal
+     * PropertiesChanged; larger values are only listed as invalidated. See
+     * #StatusNotifierItem:emit-properties-changed for more.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_PROPERTIES_CHANGED_MAX_SIZE] =
+        g_param_spec_uint ("properties-changed-max-size", "properties-changed-max-size",
+                "Maximum size of a value sent in PropertiesChanged",
+                0, G_MAXUINT,
+                8192,
+                G_PARAM_READWRITE | G_PARAM_CONSTRUCT);
+
     /**
      * StatusNotifierItem:state:
      *
@@ -570,6 +963,126 @@ status_notifier_item_class_init (StatusNotifierItemClass *klass)
                 -1, 1, -1,
                 G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
 
+    /**
+     * StatusNotifierItem:manager:
+     *
+     * The #StatusNotifierManager used by the item, if any. Items using the same
+     * manager share the watching of and connection to the
+     * StatusNotifierWatcher. See #StatusNotifierManager for more.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_MANAGER] =
+        g_param_spec_object ("manager", "manager",
+                "Manager shared with other items",
+                STATUS_NOTIFIER_TYPE_MANAGER,
+                G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+
+    /**
+     * StatusNotifierItem:fast-start:
+     *
+     * By default, registration is done one step at a time: find the
+     * StatusNotifierWatcher and load all its properties, then (if a host is
+     * registered) acquire a name on the bus, and finally register with the
+     * watcher.
+     *
+     * When %TRUE, the name is acquired (and the item object exported) while
+     * looking for the watcher, of which only property
+     * IsStatusNotifierHostRegistered is fetched, and the item is registered
+     * with the watcher as soon as both are done. This cuts the time it takes
+     * for the item to show up, e.g. on a busy bus at session start, at the cost
+     * of acquiring a name for nothing if e.g. no host is registered.
+     *
+     * If the watcher isn't there yet, or no host is registered, the name and
+     * object are kept (as when the watcher goes away once registered), so that
+     * only the registration with the watcher remains once they show up.
+     *
+     * This has no effect when not registering a name on the bus (see
+     * #StatusNotifierItem:register-name-on-bus) or when using a
+     * #StatusNotifierManager, and changes only apply to the next call to
+     * status_notifier_item_register().
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_FAST_START] =
+        g_param_spec_boolean ("fast-start", "fast-start",
+                "Whether to acquire the name concurrently with looking for the watcher",
+                FALSE,
+                G_PARAM_READWRITE);
+
+    /**
+     * StatusNotifierItem:export-stats:
+     *
+     * Whether to also export, alongside the item on the bus, a debug interface
+     * com.jjacky.StatusNotifier.Debug whose method GetStats returns the same
+     * as status_notifier_item_get_stats(). This allows to check the bus
+     * traffic of an item from outside the application, e.g. using
+     * <programlisting>
+     * gdbus call --session --dest NAME --object-path /StatusNotifierItem \
+     *      --method com.jjacky.StatusNotifier.Debug.GetStats
+     * </programlisting>
+     *
+     * Changes only apply to the next call to status_notifier_item_register().
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_EXPORT_STATS] =
+        g_param_spec_boolean ("export-stats", "export-stats",
+                "Whether to export statistics over DBus",
+                FALSE,
+                G_PARAM_READWRITE);
+
+    /**
+     * StatusNotifierItem:service-thread:
+     *
+     * Whether to serve DBus calls to the item from a dedicated thread, instead
+     * of the main context of the item.
+     *
+     * Normally all calls from hosts are handled from the item's context, so
+     * when the application is busy (e.g. rendering) and doesn't iterate its
+     * main loop, hosts wait on their calls, often leading to tooltips not
+     * showing up or clicks timing out.
+     *
+     * When %TRUE, properties are served from the thread, using values
+     * published by the item's context every time they change (before the
+     * DBus signals are emitted), and are thus always answered right away.
+     * Calls of methods (Activate, ContextMenu, etc) are forwarded to the
+     * item's context, where signals are emitted as usual, and replied to once
+     * done.
+     *
+     * This has no effect when using a #StatusNotifierManager exporting items
+     * in its subtree (see #StatusNotifierManager:export-subtree), and changes
+     * only apply to the next call to status_notifier_item_register().
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_SERVICE_THREAD] =
+        g_param_spec_boolean ("service-thread", "service-thread",
+                "Whether to serve DBus calls from a dedicated thread",
+                FALSE,
+                G_PARAM_READWRITE);
+
+    /**
+     * StatusNotifierItem:reply-first:
+     *
+     * Whether to reply to DBus method calls (Activate, SecondaryActivate,
+     * ContextMenu and Scroll) right away, and only then emit the corresponding
+     * signal, from an idle source.
+     *
+     * By default the reply is sent once the signal handlers returned, so a
+     * slow handler (e.g. one creating & showing a window) keeps the call
+     * pending on the host's side, and some hosts won't process input in the
+     * meantime. Since the return value of the handlers isn't sent to the host
+     * anyways, there's no reason not to enable this, other than the signal
+     * not being emitted from within the method call anymore.
+     *
+     * Since: 1.1.0
+     */
+    status_notifier_item_props[PROP_REPLY_FIRST] =
+        g_param_spec_boolean ("reply-first", "reply-first",
+                "Whether to reply to method calls before emitting the signals",
+                FALSE,
+                G_PARAM_READWRITE);
 
     g_object_class_install_properties (o_class, NB_PROPS, status_notifier_item_props);
 
@@ -714,9 +1227,12 @@ status_notifier_item_init (StatusNotifierItem *sn)
 #if !defined(GLIB_VERSION_2_38)
     sn->priv = G_TYPE_INSTANCE_GET_PRIVATE (sn,
             STATUS_NOTIFIER_TYPE_ITEM, StatusNotifierItemPrivate);
-#else
-    (void)sn; // suppressing unused warning
 #endif /* GLIB < 2.38 */
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    priv->context = g_main_context_ref_thread_default ();
+    priv->thread = g_thread_ref (g_thread_self ());
+    g_queue_init (&priv->raster_cache);
 }
 
 static void
@@ -794,9 +1310,54 @@ status_notifier_item_set_property (GObject            *object,
         case PROP_WINDOW_ID:
             status_notifier_item_set_window_id (sn, g_value_get_uint (value));
             break;
+        case PROP_PIXMAP_SIZES:
+            {
+                GVariant *variant = g_value_get_variant (value);
+                const gint32 *sizes = NULL;
+                gsize n = 0;
+
+                if (variant)
+                    sizes = g_variant_get_fixed_array (variant, &n, sizeof (gint32));
+                status_notifier_item_set_pixmap_sizes (sn, sizes, (guint) n);
+            }
+            break;
+        case PROP_RASTER_CACHE_SIZE:
+            status_notifier_item_set_raster_cache_size (sn, g_value_get_uint (value));
+            break;
+        case PROP_COALESCE_SIGNALS:
+            status_notifier_item_set_coalesce_signals (sn, g_value_get_boolean (value));
+            break;
+        case PROP_COMPARE_PIXBUFS:
+            status_notifier_item_set_compare_pixbufs (sn, g_value_get_boolean (value));
+            break;
+        case PROP_EMIT_PROPERTIES_CHANGED:
+            status_notifier_item_set_emit_properties_changed (sn,
+                    g_value_get_boolean (value));
+            break;
+        case PROP_PROPERTIES_CHANGED_MAX_SIZE:
+            status_notifier_item_set_properties_changed_max_size (sn,
+                    g_value_get_uint (value));
+            break;
         case PROP_REGISTER_NAME_ON_BUS:
             priv->register_bus_name = g_value_get_int (value);
             break;
+        case PROP_MANAGER:  /* G_PARAM_CONSTRUCT_ONLY */
+            priv->manager = g_value_dup_object (value);
+            if (priv->manager)
+                _status_notifier_manager_add_item (priv->manager, sn);
+            break;
+        case PROP_FAST_START:
+            status_notifier_item_set_fast_start (sn, g_value_get_boolean (value));
+            break;
+        case PROP_EXPORT_STATS:
+            status_notifier_item_set_export_stats (sn, g_value_get_boolean (value));
+            break;
+        case PROP_SERVICE_THREAD:
+            status_notifier_item_set_service_thread (sn, g_value_get_boolean (value));
+            break;
+        case PROP_REPLY_FIRST:
+            status_notifier_item_set_reply_first (sn, g_value_get_boolean (value));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
             break;
@@ -876,29 +1437,154 @@ status_notifier_item_get_property (GObject            *object,
         case PROP_WINDOW_ID:
             g_value_set_uint (value, priv->window_id);
             break;
+        case PROP_PIXMAP_SIZES:
+            if (priv->pixmap_sizes)
+                g_value_take_variant (value, g_variant_new_fixed_array (
+                            G_VARIANT_TYPE_INT32,
+                            priv->pixmap_sizes->data,
+                            priv->pixmap_sizes->len,
+                            sizeof (gint32)));
+            else
+                g_value_set_variant (value, NULL);
+            break;
+        case PROP_RASTER_CACHE_SIZE:
+            g_value_set_uint (value, priv->raster_cache_size);
+            break;
+        case PROP_COALESCE_SIGNALS:
+            g_value_set_boolean (value, priv->coalesce_signals);
+            break;
+        case PROP_COMPARE_PIXBUFS:
+            g_value_set_boolean (value, priv->compare_pixbufs);
+            break;
+        case PROP_EMIT_PROPERTIES_CHANGED:
+            g_value_set_boolean (value, priv->emit_properties_changed);
+            break;
+        case PROP_PROPERTIES_CHANGED_MAX_SIZE:
+            g_value_set_uint (value, priv->properties_changed_max_size);
+            break;
         case PROP_STATE:
             g_value_set_enum (value, priv->state);
             break;
         case PROP_REGISTER_NAME_ON_BUS:
             g_value_set_int (value, status_notifier_item_get_register_name_on_bus (sn));
             break;
+        case PROP_MANAGER:
+            g_value_set_object (value, priv->manager);
+            break;
+        case PROP_FAST_START:
+            g_value_set_boolean (value, priv->fast_start);
+            break;
+        case PROP_EXPORT_STATS:
+            g_value_set_boolean (value, priv->export_stats);
+            break;
+        case PROP_SERVICE_THREAD:
+            g_value_set_boolean (value, priv->service_thread);
+            break;
+        case PROP_REPLY_FIRST:
+            g_value_set_boolean (value, priv->reply_first);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
             break;
     }
 }
 
+/* adds an idle source calling @func in the context @sn belongs to. The
+ * returned source is owned by the context, and only valid until it's been
+ * dispatched or destroyed */
+static GSource *
+idle_add (StatusNotifierItem *sn,
+          gint                priority,
+          GSourceFunc         func,
+          gpointer            data,
+          GDestroyNotify      destroy)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GSource *source;
+
+    source = g_idle_source_new ();
+    g_source_set_priority (source, priority);
+    g_source_set_callback (source, func, data, destroy);
+    g_source_attach (source, priv->context);
+    g_source_unref (source);
+    return source;
+}
+
+/* marks the value of DBus property @prop as needing to be rebuilt */
+static void
+dbus_invalidate (StatusNotifierItem *sn, guint prop)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    priv->dbus_dirty |= 1u << prop;
+    /* for properties without signals, see dbus_flush() for the others */
+    if (priv->service && !priv->service_publish_source)
+        priv->service_publish_source = idle_add (sn, G_PRIORITY_DEFAULT_IDLE,
+                service_publish_cb, sn, NULL);
+}
+
+static void
+dbus_invalidate_icon (StatusNotifierItem *sn, StatusNotifierIcon icon)
+{
+    static const guint props[_NB_STATUS_NOTIFIER_ICONS][2] = {
+        { DBUS_PROP_ICON_NAME, DBUS_PROP_ICON_PIXMAP },
+        { DBUS_PROP_ATTENTION_ICON_NAME, DBUS_PROP_ATTENTION_ICON_PIXMAP },
+        { DBUS_PROP_OVERLAY_ICON_NAME, DBUS_PROP_OVERLAY_ICON_PIXMAP },
+        { DBUS_PROP_TOOLTIP, DBUS_PROP_TOOLTIP }
+    };
+
+    dbus_invalidate (sn, props[icon][0]);
+    dbus_invalidate (sn, props[icon][1]);
+}
+
+static void
+dbus_values_free (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    guint i;
+
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+        if (priv->dbus_values[i])
+        {
+            g_variant_unref (priv->dbus_values[i]);
+            priv->dbus_values[i] = NULL;
+        }
+    if (priv->dbus_snapshot)
+    {
+        g_variant_unref (priv->dbus_snapshot);
+        priv->dbus_snapshot = NULL;
+    }
+    priv->dbus_dirty = 0;
+}
+
 static void
 free_icon (StatusNotifierItem *sn, StatusNotifierIcon icon)
 {
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    if (priv->icon[icon].has_pixbuf)
-        g_object_unref (priv->icon[icon].pixbuf);
-    else
+    dbus_invalidate_icon (sn, icon);
+
+    if (!priv->icon[icon].has_pixbuf)
         g_free (priv->icon[icon].icon_name);
+    else if (priv->icon[icon].pixbuf)
+        g_object_unref (priv->icon[icon].pixbuf);
+    if (priv->icon[icon].data)
+    {
+        g_bytes_unref (priv->icon[icon].data);
+        priv->icon[icon].data = NULL;
+    }
+    if (priv->icon[icon].gicon)
+    {
+        g_object_unref (priv->icon[icon].gicon);
+        priv->icon[icon].gicon = NULL;
+        clear_rasters (sn, icon);
+    }
     priv->icon[icon].has_pixbuf = FALSE;
     priv->icon[icon].icon_name = NULL;
+    if (priv->icon[icon].pixmap)
+    {
+        g_variant_unref (priv->icon[icon].pixmap);
+        priv->icon[icon].pixmap = NULL;
+    }
 }
 
 static void
@@ -906,6 +1592,12 @@ dbus_free (StatusNotifierItem *sn)
 {
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    if (priv->dbus_flush_source)
+    {
+        g_source_destroy (priv->dbus_flush_source);
+        priv->dbus_flush_source = NULL;
+    }
+    priv->dbus_pending = 0;
     if (priv->dbus_watch_id > 0)
     {
         g_bus_unwatch_name (priv->dbus_watch_id);
@@ -926,6 +1618,10 @@ dbus_free (StatusNotifierItem *sn)
         g_object_unref (priv->dbus_proxy);
         priv->dbus_proxy = NULL;
     }
+    g_free (priv->fast_name);
+    priv->fast_name = NULL;
+    priv->fast_watcher_ready = FALSE;
+    priv->fast_owning = FALSE;
 #if USE_DBUSMENU
     if (priv->menu)
     {
@@ -943,11 +1639,28 @@ dbus_free (StatusNotifierItem *sn)
         g_dbus_connection_unregister_object (priv->dbus_conn, priv->dbus_reg_id);
         priv->dbus_reg_id = 0;
     }
+    service_stop (sn);
+    if (priv->dbus_debug_id > 0)
+    {
+        g_dbus_connection_unregister_object (priv->dbus_conn, priv->dbus_debug_id);
+        priv->dbus_debug_id = 0;
+    }
+    if (priv->menu_model)
+        sn_menu_unexport (priv->menu_model);
+    if (priv->object_path)
+    {
+        _status_notifier_manager_unexport_item (priv->manager, sn);
+        g_free (priv->object_path);
+        priv->object_path = NULL;
+    }
     if (priv->dbus_conn)
     {
         g_object_unref (priv->dbus_conn);
         priv->dbus_conn = NULL;
     }
+    g_free (priv->dbus_name);
+    priv->dbus_name = NULL;
+    dbus_values_free (sn);
 }
 
 static void
@@ -962,20 +1675,111 @@ status_notifier_item_finalize (GObject *object)
     g_free (priv->title);
     for (i = 0; i < _NB_STATUS_NOTIFIER_ICONS; ++i)
         free_icon (sn, i);
+    g_list_free_full (priv->raster_cache.head, (GDestroyNotify) free_raster);
     g_free (priv->attention_movie_name);
     g_free (priv->tooltip_title);
     g_free (priv->tooltip_body);
+    if (priv->pixmap_sizes)
+        g_array_unref (priv->pixmap_sizes);
 
     dbus_free (sn);
+    if (priv->menu_model)
+        sn_menu_free (priv->menu_model);
+    if (priv->providers)
+        g_hash_table_unref (priv->providers);
+    if (priv->manager)
+    {
+        _status_notifier_manager_remove_item (priv->manager, sn);
+        g_object_unref (priv->manager);
+    }
+    /* (the source applying them holds a ref, so only if it never ran) */
+    while (priv->updates)
+    {
+        Update *update = priv->updates;
+
+        priv->updates = update->next;
+        free_update (update);
+    }
+    g_main_context_unref (priv->context);
+    g_thread_unref (priv->thread);
 
     G_OBJECT_CLASS (status_notifier_item_parent_class)->finalize (object);
 }
 
+static void
+dbus_emit (StatusNotifierItem *sn, guint signal)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GVariant *params = NULL;
+
+    if (signal == DBUS_SIGNAL_NEW_STATUS)
+    {
+        const gchar * const s_status[] = {
+            "Passive",
+            "Active",
+            "NeedsAttention"
+        };
+        params = g_variant_new ("(s)", s_status[priv->status]);
+    }
+
+    ++priv->stats_signals[signal];
+    g_dbus_connection_emit_signal (priv->dbus_conn,
+            NULL,
+            object_path (priv),
+            ITEM_INTERFACE,
+            dbus_signal_names[signal],
+            params,
+            NULL);
+}
+
+/* emits all pending DBus signals, each one only once */
+static void
+dbus_flush (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    guint pending;
+    guint signal;
+
+    if (priv->dbus_flush_source)
+    {
+        g_source_destroy (priv->dbus_flush_source);
+        priv->dbus_flush_source = NULL;
+    }
+
+    /* hosts will come get the new values */
+    service_publish (sn);
+
+    pending = priv->dbus_pending;
+    priv->dbus_pending = 0;
+    if (priv->state != STATUS_NOTIFIER_STATE_REGISTERED)
+        return;
+
+    for (signal = 0; signal < NB_DBUS_SIGNALS; ++signal)
+        if (pending & (1 << signal))
+            dbus_emit (sn, signal);
+    if (priv->emit_properties_changed && pending)
+        dbus_emit_properties_changed (sn, pending);
+}
+
+static gboolean
+dbus_flush_cb (gpointer data)
+{
+    StatusNotifierItem *sn = data;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    priv->dbus_flush_source = NULL;
+    /* in the middle of an update, status_notifier_item_commit_update() will
+     * take care of it */
+    if (priv->update_freeze == 0)
+        dbus_flush (sn);
+    return G_SOURCE_REMOVE;
+}
+
 static void
 dbus_notify (StatusNotifierItem *sn, guint prop)
 {
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-    const gchar *signal;
+    guint signal;
 
     if (priv->state !=  STATUS_NOTIFIER_STATE_REGISTERED)
         return;
@@ -983,55 +1787,275 @@ dbus_notify (StatusNotifierItem *sn, guint prop)
     switch (prop)
     {
         case PROP_STATUS:
-            {
-                const gchar * const s_status[] = {
-                    "Passive",
-                    "Active",
-                    "NeedsAttention"
-                };
-                signal = "NewStatus";
-                g_dbus_connection_emit_signal (priv->dbus_conn,
-                        NULL,
-                        ITEM_OBJECT,
-                        ITEM_INTERFACE,
-                        signal,
-                        g_variant_new ("(s)", s_status[priv->status]),
-                        NULL);
-                return;
-            }
+            signal = DBUS_SIGNAL_NEW_STATUS;
+            break;
         case PROP_TITLE:
-            signal = "NewTitle";
+            signal = DBUS_SIGNAL_NEW_TITLE;
             break;
         case PROP_MAIN_ICON_NAME:
         case PROP_MAIN_ICON_PIXBUF:
-            signal = "NewIcon";
+            signal = DBUS_SIGNAL_NEW_ICON;
             break;
         case PROP_ATTENTION_ICON_NAME:
         case PROP_ATTENTION_ICON_PIXBUF:
-            signal = "NewAttentionIcon";
+            signal = DBUS_SIGNAL_NEW_ATTENTION_ICON;
             break;
         case PROP_OVERLAY_ICON_NAME:
         case PROP_OVERLAY_ICON_PIXBUF:
-            signal = "NewOverlayIcon";
+            signal = DBUS_SIGNAL_NEW_OVERLAY_ICON;
             break;
         case PROP_TOOLTIP_TITLE:
         case PROP_TOOLTIP_BODY:
         case PROP_TOOLTIP_ICON_NAME:
         case PROP_TOOLTIP_ICON_PIXBUF:
-            signal = "NewToolTip";
+            signal = DBUS_SIGNAL_NEW_TOOLTIP;
             break;
         default:
             g_return_if_reached ();
     }
 
-    g_dbus_connection_emit_signal (priv->dbus_conn,
-            NULL,
-            ITEM_OBJECT,
-            ITEM_INTERFACE,
-            signal,
-            NULL,
-            NULL);
-}
+    if (signal == DBUS_SIGNAL_NEW_TOOLTIP && priv->tooltip_freeze > 0)
+    {
+        priv->tooltip_changed = TRUE;
+        return;
+    }
+
+    if (!priv->coalesce_signals && priv->update_freeze == 0)
+    {
+        service_publish (sn);
+        dbus_emit (sn, signal);
+        if (priv->emit_properties_changed)
+            dbus_emit_properties_changed (sn, 1 << signal);
+        return;
+    }
+
+    priv->dbus_pending |= 1 << signal;
+    if (!priv->dbus_flush_source && priv->update_freeze == 0)
+        priv->dbus_flush_source = idle_add (sn, G_PRIORITY_DEFAULT_IDLE,
+                dbus_flush_cb, sn, NULL);
+}
+
+/* whether we're in the thread/context @sn belongs to; if not, changes must go
+ * through queue_update() */
+static inline gboolean
+is_owner (StatusNotifierItemPrivate *priv)
+{
+    return priv->thread == g_thread_self ()
+        || g_main_context_is_owner (priv->context);
+}
+
+static void
+free_update (Update *update)
+{
+    if (update->pixbuf)
+        g_object_unref (update->pixbuf);
+    if (update->bytes)
+        g_bytes_unref (update->bytes);
+    if (update->gicon)
+        g_object_unref (update->gicon);
+    g_free (update->str[0]);
+    g_free (update->str[1]);
+    g_free (update->str[2]);
+    g_slice_free (Update, update);
+}
+
+/* updates with the same key set the same thing, so only the last one needs to
+ * be applied. Returns 0 for updates that must always be applied */
+static guint
+update_key (Update *update)
+{
+    switch (update->op)
+    {
+        case UPDATE_ICON_NAME:
+        case UPDATE_ICON_PIXBUF:
+        case UPDATE_ICON_BYTES:
+        case UPDATE_ICON_GICON:
+            return 1u << update->icon;
+        case UPDATE_TOOLTIP_WITH_PIXBUF:
+            return 1u << (_NB_STATUS_NOTIFIER_ICONS + UPDATE_TOOLTIP);
+        case UPDATE_FREEZE_TOOLTIP:
+        case UPDATE_THAW_TOOLTIP:
+        case UPDATE_BEGIN:
+        case UPDATE_COMMIT:
+            return 0;
+        default:
+            return 1u << (_NB_STATUS_NOTIFIER_ICONS + update->op);
+    }
+}
+
+static void
+apply_update (StatusNotifierItem *sn, Update *update)
+{
+    switch (update->op)
+    {
+        case UPDATE_ICON_NAME:
+            status_notifier_item_set_from_icon_name (sn, update->icon,
+                    update->str[0]);
+            break;
+        case UPDATE_ICON_PIXBUF:
+            status_notifier_item_set_from_pixbuf (sn, update->icon,
+                    update->pixbuf);
+            break;
+        case UPDATE_ICON_BYTES:
+            status_notifier_item_set_from_bytes (sn, update->icon,
+                    update->bytes);
+            break;
+        case UPDATE_ICON_GICON:
+            status_notifier_item_set_from_gicon (sn, update->icon,
+                    update->gicon);
+            break;
+        case UPDATE_ATTENTION_MOVIE_NAME:
+            status_notifier_item_set_attention_movie_name (sn, update->str[0]);
+            break;
+        case UPDATE_TITLE:
+            status_notifier_item_set_title (sn, update->str[0]);
+            break;
+        case UPDATE_STATUS:
+            status_notifier_item_set_status (sn, update->value);
+            break;
+        case UPDATE_WINDOW_ID:
+            status_notifier_item_set_window_id (sn, update->value);
+            break;
+        case UPDATE_TOOLTIP:
+            status_notifier_item_set_tooltip (sn, update->str[0],
+                    update->str[1], update->str[2]);
+            break;
+        case UPDATE_TOOLTIP_WITH_PIXBUF:
+            status_notifier_item_set_tooltip_with_pixbuf (sn, update->pixbuf,
+                    update->str[1], update->str[2]);
+            break;
+        case UPDATE_TOOLTIP_TITLE:
+            status_notifier_item_set_tooltip_title (sn, update->str[0]);
+            break;
+        case UPDATE_TOOLTIP_BODY:
+            status_notifier_item_set_tooltip_body (sn, update->str[0]);
+            break;
+        case UPDATE_ITEM_IS_MENU:
+            status_notifier_item_set_item_is_menu (sn, update->value);
+            break;
+        case UPDATE_FREEZE_TOOLTIP:
+            status_notifier_item_freeze_tooltip (sn);
+            break;
+        case UPDATE_THAW_TOOLTIP:
+            status_notifier_item_thaw_tooltip (sn);
+            break;
+        case UPDATE_BEGIN:
+            status_notifier_item_begin_update (sn);
+            break;
+        case UPDATE_COMMIT:
+            status_notifier_item_commit_update (sn);
+            break;
+    }
+}
+
+static gboolean
+apply_updates (gpointer data)
+{
+    StatusNotifierItem *sn = (StatusNotifierItem *) data;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Update *updates, *update, *list = NULL;
+    guint seen = 0;
+
+    /* take them all at once, new ones will trigger another call */
+    do
+        updates = g_atomic_pointer_get (&priv->updates);
+    while (!g_atomic_pointer_compare_and_exchange (&priv->updates, updates, NULL));
+
+    /* most recent first: drop those overridden later, and reverse the order */
+    while (updates)
+    {
+        guint key;
+
+        update = updates;
+        updates = update->next;
+
+        key = update_key (update);
+        if (seen & key)
+        {
+            free_update (update);
+            continue;
+        }
+        seen |= key;
+        update->next = list;
+        list = update;
+    }
+
+    status_notifier_item_begin_update (sn);
+    while (list)
+    {
+        update = list;
+        list = update->next;
+        apply_update (sn, update);
+        free_update (update);
+    }
+    status_notifier_item_commit_update (sn);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* called from another thread than the one @sn belongs to, have the change
+ * applied from its context. This is a lock-free stack, with a source added to
+ * the context when the first change is pushed. */
+static void
+queue_update (StatusNotifierItem *sn,
+              guint               op,
+              StatusNotifierIcon  icon,
+              guint               value,
+              GdkPixbuf          *pixbuf,
+              const gchar        *str0,
+              const gchar        *str1,
+              const gchar        *str2)
+{
+    Update *update;
+
+    update = g_slice_new (Update);
+    update->op = op;
+    update->icon = icon;
+    update->value = value;
+    update->pixbuf = (pixbuf) ? g_object_ref (pixbuf) : NULL;
+    update->bytes = NULL;
+    update->gicon = NULL;
+    update->str[0] = g_strdup (str0);
+    update->str[1] = g_strdup (str1);
+    update->str[2] = g_strdup (str2);
+    push_update (sn, update);
+}
+
+/* queues setting @icon from @bytes or @gicon, see queue_update() */
+static void
+queue_update_icon (StatusNotifierItem *sn,
+                   guint               op,
+                   StatusNotifierIcon  icon,
+                   GBytes             *bytes,
+                   GIcon              *gicon)
+{
+    Update *update;
+
+    update = g_slice_new0 (Update);
+    update->op = op;
+    update->icon = icon;
+    update->bytes = (bytes) ? g_bytes_ref (bytes) : NULL;
+    update->gicon = (gicon) ? g_object_ref (gicon) : NULL;
+    push_update (sn, update);
+}
+
+static void
+push_update (StatusNotifierItem *sn, Update *update)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Update *head;
+
+    do
+    {
+        head = g_atomic_pointer_get (&priv->updates);
+        update->next = head;
+    }
+    while (!g_atomic_pointer_compare_and_exchange (&priv->updates, head, update));
+
+    if (!head)
+        idle_add (sn, G_PRIORITY_DEFAULT, apply_updates, g_object_ref (sn),
+                g_object_unref);
+}
 
 /**
  * status_notifier_item_new_from_pixbuf:
@@ -1112,6 +2136,43 @@ status_notifier_item_get_category (StatusNotifierItem      *sn)
     return priv->category;
 }
 
+/* whether both pixbufs hold the same image; padding at the end of rows isn't
+ * part of it, hence compared row by row */
+static gboolean
+same_pixbuf (GdkPixbuf *a, GdkPixbuf *b)
+{
+    const guint8 *pa, *pb;
+    gint width, height, n_channels, rs_a, rs_b;
+    gsize row_len;
+    gint y;
+
+    if (!a || !b)
+        return FALSE;
+
+    width = gdk_pixbuf_get_width (a);
+    height = gdk_pixbuf_get_height (a);
+    n_channels = gdk_pixbuf_get_n_channels (a);
+    if (width != gdk_pixbuf_get_width (b)
+            || height != gdk_pixbuf_get_height (b)
+            || n_channels != gdk_pixbuf_get_n_channels (b)
+            || gdk_pixbuf_get_has_alpha (a) != gdk_pixbuf_get_has_alpha (b)
+            || gdk_pixbuf_get_bits_per_sample (a) != gdk_pixbuf_get_bits_per_sample (b))
+        return FALSE;
+
+    pa = gdk_pixbuf_read_pixels (a);
+    pb = gdk_pixbuf_read_pixels (b);
+    rs_a = gdk_pixbuf_get_rowstride (a);
+    rs_b = gdk_pixbuf_get_rowstride (b);
+    row_len = (gsize) width * (gsize) n_channels
+        * (gsize) ((gdk_pixbuf_get_bits_per_sample (a) + 7) / 8);
+
+    for (y = 0; y < height; ++y, pa += rs_a, pb += rs_b)
+        if (memcmp (pa, pb, row_len) != 0)
+            return FALSE;
+
+    return TRUE;
+}
+
 /**
  * status_notifier_item_set_from_pixbuf:
  * @sn: A #StatusNotifierItem
@@ -1125,6 +2186,11 @@ status_notifier_item_get_category (StatusNotifierItem      *sn)
  *
  * It is currently not possible to set both, as setting one will unset the
  * other.
+ *
+ * Nothing is done if @icon is already set to @pixbuf (or the same image, see
+ * #StatusNotifierItem:compare-pixbufs). Note that this means after modifying
+ * the pixels of the #GdkPixbuf in use, you need to set a new one (e.g. a copy)
+ * for the change to be picked up.
  */
 void
 status_notifier_item_set_from_pixbuf (StatusNotifierItem      *sn,
@@ -1134,13 +2200,27 @@ status_notifier_item_set_from_pixbuf (StatusNotifierItem      *sn,
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_ICON_PIXBUF, icon, 0, pixbuf, NULL, NULL, NULL);
+        return;
+    }
+
+    if (priv->icon[icon].has_pixbuf
+            && (priv->icon[icon].pixbuf == pixbuf
+                || (priv->compare_pixbufs
+                    && same_pixbuf (priv->icon[icon].pixbuf, pixbuf))))
+        return;
+
     free_icon (sn, icon);
     priv->icon[icon].has_pixbuf = TRUE;
     priv->icon[icon].pixbuf = g_object_ref (pixbuf);
+    /* scale to all requested sizes now, rather than when a host asks */
+    if (priv->pixmap_sizes)
+        get_icon_pixmap (sn, icon);
 
     notify (sn, prop_name_from_icon[icon]);
-    if (icon != STATUS_NOTIFIER_TOOLTIP_ICON || priv->tooltip_freeze == 0)
-        dbus_notify (sn, prop_name_from_icon[icon]);
+    dbus_notify (sn, prop_name_from_icon[icon]);
 }
 
 /**
@@ -1165,12 +2245,170 @@ status_notifier_item_set_from_icon_name (StatusNotifierItem      *sn,
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_ICON_NAME, icon, 0, NULL, icon_name, NULL, NULL);
+        return;
+    }
+
+    if (!priv->icon[icon].has_pixbuf
+            && !g_strcmp0 (priv->icon[icon].icon_name, icon_name))
+        return;
+
     free_icon (sn, icon);
     priv->icon[icon].icon_name = g_strdup (icon_name);
 
     notify (sn, prop_pixbuf_from_icon[icon]);
-    if (icon != STATUS_NOTIFIER_TOOLTIP_ICON || priv->tooltip_freeze == 0)
-        dbus_notify (sn, prop_name_from_icon[icon]);
+    dbus_notify (sn, prop_name_from_icon[icon]);
+}
+
+/**
+ * status_notifier_item_set_from_bytes:
+ * @sn: A #StatusNotifierItem
+ * @icon: Which icon to set
+ * @bytes: Encoded image data (e.g. the content of a PNG file) to use for @icon
+ *
+ * Sets the icon @icon to the image in @bytes, in any format supported by
+ * #GdkPixbufLoader.
+ *
+ * This is like status_notifier_item_set_from_pixbuf() except that @bytes are
+ * only decoded when needed, i.e. when a host first asks for the icon (or its
+ * #GdkPixbuf is requested), and the decoded image isn't kept once serialized
+ * for DBus. This avoids decoding at startup icons that might never be shown
+ * (e.g. attention or overlay icons), and keeping them decoded in memory.
+ *
+ * If @bytes can't be decoded, a warning is emitted then and the icon treated
+ * as empty.
+ *
+ * Nothing is done if @icon is already set to the same data.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_from_bytes (StatusNotifierItem      *sn,
+                                     StatusNotifierIcon       icon,
+                                     GBytes                  *bytes)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (bytes != NULL);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update_icon (sn, UPDATE_ICON_BYTES, icon, bytes, NULL);
+        return;
+    }
+
+    if (priv->icon[icon].data && g_bytes_equal (priv->icon[icon].data, bytes))
+        return;
+
+    free_icon (sn, icon);
+    priv->icon[icon].has_pixbuf = TRUE;
+    priv->icon[icon].pixbuf = NULL;
+    priv->icon[icon].data = g_bytes_ref (bytes);
+
+    notify (sn, prop_name_from_icon[icon]);
+    dbus_notify (sn, prop_name_from_icon[icon]);
+}
+
+/**
+ * status_notifier_item_set_from_file:
+ * @sn: A #StatusNotifierItem
+ * @icon: Which icon to set
+ * @filename: Name of an image file to use for @icon
+ * @error: (allow-none): Return location for a #GError, or %NULL
+ *
+ * Sets the icon @icon to the image in @filename. The file is read right away,
+ * but only decoded when needed, see status_notifier_item_set_from_bytes()
+ *
+ * Returns: %TRUE if @filename could be read, else %FALSE with @error set
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_item_set_from_file (StatusNotifierItem      *sn,
+                                    StatusNotifierIcon       icon,
+                                    const gchar             *filename,
+                                    GError                 **error)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
+    g_return_val_if_fail (filename != NULL, FALSE);
+    GBytes *bytes;
+    gchar *contents;
+    gsize len;
+
+    if (!g_file_get_contents (filename, &contents, &len, error))
+        return FALSE;
+
+    bytes = g_bytes_new_take (contents, len);
+    status_notifier_item_set_from_bytes (sn, icon, bytes);
+    g_bytes_unref (bytes);
+    return TRUE;
+}
+
+/**
+ * status_notifier_item_set_from_gicon:
+ * @sn: A #StatusNotifierItem
+ * @icon: Which icon to set
+ * @gicon: A #GIcon to use for @icon
+ *
+ * Sets the icon @icon to @gicon, which must either be a #GThemedIcon or a
+ * #GLoadableIcon (e.g. #GFileIcon or #GBytesIcon).
+ *
+ * A #GThemedIcon is the same as using status_notifier_item_set_from_icon_name()
+ * with its first name.
+ *
+ * Other icons are sent as pixmaps, rendered from @gicon at each of the pixmap
+ * sizes (see status_notifier_item_set_pixmap_sizes()), or at its native size
+ * if none are set. This is meant for scalable (e.g. SVG) icons, which are then
+ * crisp at every size instead of scaled from a single image. Rendering is only
+ * done when a host first asks for the icon, and renders are kept in a cache
+ * shared by all icons of @sn, so that switching back to previously used sizes
+ * is cheap. Renders not currently in use are only kept within the budget of
+ * #StatusNotifierItem:raster-cache-size.
+ *
+ * If @gicon can't be loaded (e.g. a #GFileIcon of a missing or corrupt file),
+ * a warning is emitted then and the icon sent as empty, including as tooltip
+ * icon.
+ *
+ * Nothing is done if @icon is already set to an equal #GIcon.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_from_gicon (StatusNotifierItem      *sn,
+                                     StatusNotifierIcon       icon,
+                                     GIcon                   *gicon)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (G_IS_THEMED_ICON (gicon) || G_IS_LOADABLE_ICON (gicon));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update_icon (sn, UPDATE_ICON_GICON, icon, NULL, gicon);
+        return;
+    }
+
+    if (G_IS_THEMED_ICON (gicon))
+    {
+        const gchar * const *names;
+
+        names = g_themed_icon_get_names (G_THEMED_ICON (gicon));
+        status_notifier_item_set_from_icon_name (sn, icon, names[0]);
+        return;
+    }
+
+    if (priv->icon[icon].gicon && g_icon_equal (priv->icon[icon].gicon, gicon))
+        return;
+
+    free_icon (sn, icon);
+    priv->icon[icon].has_pixbuf = TRUE;
+    priv->icon[icon].pixbuf = NULL;
+    priv->icon[icon].gicon = g_object_ref (gicon);
+
+    notify (sn, prop_name_from_icon[icon]);
+    dbus_notify (sn, prop_name_from_icon[icon]);
 }
 
 /**
@@ -1201,6 +2439,9 @@ status_notifier_item_has_pixbuf (StatusNotifierItem      *sn,
  * Returns the #GdkPixbuf set for @icon, if there's one. Not that it will return
  * %NULL if an icon name is set.
  *
+ * If @icon was set via status_notifier_item_set_from_bytes() this requires
+ * decoding it, and might return %NULL if that failed.
+ *
  * Returns: (transfer full): The #GdkPixbuf set for @icon, or %NULL
  */
 GdkPixbuf *
@@ -1208,12 +2449,37 @@ status_notifier_item_get_pixbuf (StatusNotifierItem      *sn,
                                  StatusNotifierIcon       icon)
 {
     g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
-    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GdkPixbuf *pixbuf;
 
-    if (!priv->icon[icon].has_pixbuf)
-        return NULL;
+    pixbuf = get_icon_pixbuf (sn, icon);
+    return (pixbuf) ? g_object_ref (pixbuf) : NULL;
+}
+
+/**
+ * status_notifier_item_get_pixmap_cache_stats:
+ * @sn: A #StatusNotifierItem
+ * @hits: (out) (allow-none): Return location for the number of cache hits
+ * @misses: (out) (allow-none): Return location for the number of cache misses
+ *
+ * The DBus representation of icons set via #GdkPixbuf is only computed once,
+ * when first requested by a host, and then kept until the icon changes. This
+ * returns how many requests were served from that cache (@hits) and how many
+ * required to serialize the icon (@misses).
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_get_pixmap_cache_stats (StatusNotifierItem      *sn,
+                                             guint                   *hits,
+                                             guint                   *misses)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    return g_object_ref (priv->icon[icon].pixbuf);
+    if (hits)
+        *hits = priv->pixmap_cache_hits;
+    if (misses)
+        *misses = priv->pixmap_cache_misses;
 }
 
 /**
@@ -1236,105 +2502,280 @@ status_notifier_item_get_register_name_on_bus (StatusNotifierItem *sn)
 }
 
 /**
- * status_notifier_item_get_icon_name:
+ * status_notifier_item_get_manager:
  * @sn: A #StatusNotifierItem
- * @icon: The icon to get
  *
- * Returns the icon name set for @icon, if there's one. Not that it will return
- * %NULL if a #GdkPixbuf is set.
+ * Returns the #StatusNotifierManager used by @sn, if any. See
+ * #StatusNotifierItem:manager
  *
- * Returns: (transfer full): A newly allocated string of the icon name set for
- * @icon, free using g_free()
+ * Returns: (transfer none): The #StatusNotifierManager, or %NULL
+ *
+ * Since: 1.1.0
  */
-gchar *
-status_notifier_item_get_icon_name (StatusNotifierItem      *sn,
-                                    StatusNotifierIcon       icon)
+StatusNotifierManager *
+status_notifier_item_get_manager (StatusNotifierItem      *sn)
 {
     g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
-    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-
-    if (priv->icon[icon].has_pixbuf)
-        return NULL;
 
-    return g_strdup (priv->icon[icon].icon_name);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->manager;
 }
 
 /**
- * status_notifier_item_set_attention_movie_name:
+ * status_notifier_item_set_fast_start:
  * @sn: A #StatusNotifierItem
- * @movie_name: The name of the movie
+ * @fast_start: Whether to acquire the name while looking for the watcher
  *
- * In addition to the icon, the item can also specify an animation associated to
- * the #STATUS_NOTIFIER_STATUS_NEEDS_ATTENTION status.
+ * Sets whether the name on the bus is acquired concurrently with looking for
+ * the StatusNotifierWatcher. See #StatusNotifierItem:fast-start for more.
  *
- * This should be either a Freedesktop-compliant icon name or a full path.  The
- * visualization can chose between the movie or icon (or using neither of those)
- * at its discretion.
+ * Since: 1.1.0
  */
 void
-status_notifier_item_set_attention_movie_name (StatusNotifierItem      *sn,
-                                               const gchar             *movie_name)
+status_notifier_item_set_fast_start (StatusNotifierItem      *sn,
+                                     gboolean                 fast_start)
 {
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    g_free (priv->attention_movie_name);
-    priv->attention_movie_name = g_strdup (movie_name);
+    fast_start = !!fast_start;
+    if (priv->fast_start == fast_start)
+        return;
 
-    notify (sn, PROP_ATTENTION_MOVIE_NAME);
+    priv->fast_start = fast_start;
+    notify (sn, PROP_FAST_START);
 }
 
 /**
- * status_notifier_item_get_attention_movie_name:
+ * status_notifier_item_get_fast_start:
  * @sn: A #StatusNotifierItem
  *
- * Returns the movie name set for animation associated with the
- * #STATUS_NOTIFIER_STATUS_NEEDS_ATTENTION status
+ * Returns whether the name on the bus is acquired concurrently with looking
+ * for the StatusNotifierWatcher. See #StatusNotifierItem:fast-start for more.
  *
- * Returns: A newly allocated string with the movie name, free using g_free()
- * when done
+ * Returns: Whether the name is acquired while looking for the watcher
+ *
+ * Since: 1.1.0
  */
-gchar *
-status_notifier_item_get_attention_movie_name (StatusNotifierItem      *sn)
+gboolean
+status_notifier_item_get_fast_start (StatusNotifierItem      *sn)
 {
-    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
 
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-    return g_strdup (priv->attention_movie_name);
+    return priv->fast_start;
 }
 
 /**
- * status_notifier_item_set_title:
+ * status_notifier_item_set_service_thread:
  * @sn: A #StatusNotifierItem
- * @title: The title
+ * @service_thread: Whether to serve DBus calls from a dedicated thread
  *
- * Sets the title of the item (might be used by visualization e.g. in menu of
- * hidden items when #STATUS_NOTIFIER_STATUS_PASSIVE)
+ * Sets whether DBus calls to the item are served from a dedicated thread. See
+ * #StatusNotifierItem:service-thread for more.
+ *
+ * Since: 1.1.0
  */
 void
-status_notifier_item_set_title (StatusNotifierItem      *sn,
-                                const gchar             *title)
+status_notifier_item_set_service_thread (StatusNotifierItem      *sn,
+                                         gboolean                 service_thread)
 {
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    g_free (priv->title);
-    priv->title = g_strdup (title);
+    service_thread = !!service_thread;
+    if (priv->service_thread == service_thread)
+        return;
 
-    notify (sn, PROP_TITLE);
-    dbus_notify (sn, PROP_TITLE);
+    priv->service_thread = service_thread;
+    notify (sn, PROP_SERVICE_THREAD);
 }
 
 /**
- * status_notifier_item_get_title:
+ * status_notifier_item_get_service_thread:
  * @sn: A #StatusNotifierItem
  *
- * Returns the title of the item
+ * Returns whether DBus calls to the item are served from a dedicated thread.
+ * See #StatusNotifierItem:service-thread for more.
  *
- * Returns: A newly allocated string, free with g_free() when done
+ * Returns: Whether DBus calls are served from a dedicated thread
+ *
+ * Since: 1.1.0
  */
-gchar *
-status_notifier_item_get_title (StatusNotifierItem      *sn)
+gboolean
+status_notifier_item_get_service_thread (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->service_thread;
+}
+
+/**
+ * status_notifier_item_set_reply_first:
+ * @sn: A #StatusNotifierItem
+ * @reply_first: Whether to reply to method calls before emitting the signals
+ *
+ * Sets whether DBus method calls are replied to before the corresponding
+ * signal is emitted. See #StatusNotifierItem:reply-first for more.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_reply_first (StatusNotifierItem      *sn,
+                                      gboolean                 reply_first)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    reply_first = !!reply_first;
+    if (priv->reply_first == reply_first)
+        return;
+
+    priv->reply_first = reply_first;
+    notify (sn, PROP_REPLY_FIRST);
+}
+
+/**
+ * status_notifier_item_get_reply_first:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns whether DBus method calls are replied to before the corresponding
+ * signal is emitted. See #StatusNotifierItem:reply-first for more.
+ *
+ * Returns: Whether method calls are replied to before emitting the signals
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_item_get_reply_first (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->reply_first;
+}
+
+/**
+ * status_notifier_item_get_icon_name:
+ * @sn: A #StatusNotifierItem
+ * @icon: The icon to get
+ *
+ * Returns the icon name set for @icon, if there's one. Not that it will return
+ * %NULL if a #GdkPixbuf is set.
+ *
+ * Returns: (transfer full): A newly allocated string of the icon name set for
+ * @icon, free using g_free()
+ */
+gchar *
+status_notifier_item_get_icon_name (StatusNotifierItem      *sn,
+                                    StatusNotifierIcon       icon)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->icon[icon].has_pixbuf)
+        return NULL;
+
+    return g_strdup (priv->icon[icon].icon_name);
+}
+
+/**
+ * status_notifier_item_set_attention_movie_name:
+ * @sn: A #StatusNotifierItem
+ * @movie_name: The name of the movie
+ *
+ * In addition to the icon, the item can also specify an animation associated to
+ * the #STATUS_NOTIFIER_STATUS_NEEDS_ATTENTION status.
+ *
+ * This should be either a Freedesktop-compliant icon name or a full path.  The
+ * visualization can chose between the movie or icon (or using neither of those)
+ * at its discretion.
+ */
+void
+status_notifier_item_set_attention_movie_name (StatusNotifierItem      *sn,
+                                               const gchar             *movie_name)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_ATTENTION_MOVIE_NAME, 0, 0, NULL, movie_name, NULL, NULL);
+        return;
+    }
+
+    if (!g_strcmp0 (priv->attention_movie_name, movie_name))
+        return;
+
+    g_free (priv->attention_movie_name);
+    priv->attention_movie_name = g_strdup (movie_name);
+    dbus_invalidate (sn, DBUS_PROP_ATTENTION_MOVIE_NAME);
+
+    notify (sn, PROP_ATTENTION_MOVIE_NAME);
+}
+
+/**
+ * status_notifier_item_get_attention_movie_name:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the movie name set for animation associated with the
+ * #STATUS_NOTIFIER_STATUS_NEEDS_ATTENTION status
+ *
+ * Returns: A newly allocated string with the movie name, free using g_free()
+ * when done
+ */
+gchar *
+status_notifier_item_get_attention_movie_name (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_strdup (priv->attention_movie_name);
+}
+
+/**
+ * status_notifier_item_set_title:
+ * @sn: A #StatusNotifierItem
+ * @title: The title
+ *
+ * Sets the title of the item (might be used by visualization e.g. in menu of
+ * hidden items when #STATUS_NOTIFIER_STATUS_PASSIVE)
+ */
+void
+status_notifier_item_set_title (StatusNotifierItem      *sn,
+                                const gchar             *title)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_TITLE, 0, 0, NULL, title, NULL, NULL);
+        return;
+    }
+
+    if (!g_strcmp0 (priv->title, title))
+        return;
+
+    g_free (priv->title);
+    priv->title = g_strdup (title);
+    dbus_invalidate (sn, DBUS_PROP_TITLE);
+
+    notify (sn, PROP_TITLE);
+    dbus_notify (sn, PROP_TITLE);
+}
+
+/**
+ * status_notifier_item_get_title:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the title of the item
+ *
+ * Returns: A newly allocated string, free with g_free() when done
+ */
+gchar *
+status_notifier_item_get_title (StatusNotifierItem      *sn)
 {
     g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
 
@@ -1357,7 +2798,17 @@ status_notifier_item_set_status (StatusNotifierItem      *sn,
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_STATUS, 0, status, NULL, NULL, NULL, NULL);
+        return;
+    }
+
+    if (priv->status == status)
+        return;
+
     priv->status = status;
+    dbus_invalidate (sn, DBUS_PROP_STATUS);
 
     notify (sn, PROP_STATUS);
     dbus_notify (sn, PROP_STATUS);
@@ -1398,7 +2849,17 @@ status_notifier_item_set_window_id (StatusNotifierItem      *sn,
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_WINDOW_ID, 0, window_id, NULL, NULL, NULL, NULL);
+        return;
+    }
+
+    if (priv->window_id == window_id)
+        return;
+
     priv->window_id = window_id;
+    dbus_invalidate (sn, DBUS_PROP_WINDOW_ID);
 
     notify (sn, PROP_WINDOW_ID);
 }
@@ -1422,438 +2883,2144 @@ status_notifier_item_get_window_id (StatusNotifierItem      *sn)
 }
 
 /**
- * status_notifier_item_freeze_tooltip:
- * @sn:A #StatusNotifierItem
+ * status_notifier_item_set_coalesce_signals:
+ * @sn: A #StatusNotifierItem
+ * @coalesce: Whether to coalesce DBus signals
  *
- * Increases the freeze count for tooltip on @sn. If the freeze count is
- * non-zero, the emission of a DBus signal for StatusNotifierHost to refresh the
- * ToolTip property will be blocked until the freeze count drops back to zero
- * (via status_notifier_item_thaw_tooltip())
+ * Sets whether DBus signals about changes are emitted from an idle source,
+ * each signal being emitted only once no matter how many changes were made
+ * (the default), or immediately after each change.
  *
- * This is to allow to set the different properties forming the tooltip (title,
- * body and icon) without triggering a refresh afetr each change (as there is a
- * single property ToolTip on the DBus item, with all data).
+ * Turning it off will emit any pending signals right away.
  *
- * Every call to status_notifier_item_freeze_tooltip() should later be followed by a
- * call to status_notifier_item_thaw_tooltip()
+ * Since: 1.1.0
  */
 void
-status_notifier_item_freeze_tooltip (StatusNotifierItem      *sn)
+status_notifier_item_set_coalesce_signals (StatusNotifierItem      *sn,
+                                           gboolean                 coalesce)
 {
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    coalesce = !!coalesce;
+    if (priv->coalesce_signals == coalesce)
+        return;
+
+    priv->coalesce_signals = coalesce;
+    if (!coalesce)
+        dbus_flush (sn);
+
+    notify (sn, PROP_COALESCE_SIGNALS);
+}
+
+/**
+ * status_notifier_item_get_coalesce_signals:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns whether DBus signals are coalesced. See
+ * status_notifier_item_set_coalesce_signals() for more.
+ *
+ * Returns: Whether DBus signals are coalesced
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_item_get_coalesce_signals (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
 
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-    ++priv->tooltip_freeze;
+    return priv->coalesce_signals;
 }
 
 /**
- * status_notifier_item_thaw_tooltip:
+ * status_notifier_item_set_compare_pixbufs:
  * @sn: A #StatusNotifierItem
+ * @compare: Whether to compare pixel data of pixbufs
  *
- * Reverts the effect of a previous call to status_notifier_item_freeze_tooltip(). If
- * the freeze count drops back to zero, a signal NewToolTip will be emitted on
- * the DBus object for @sn, for StatusNotifierHost to refresh its ToolTip
- * property.
+ * Sets whether setting an icon to a #GdkPixbuf with the same image as the
+ * current one is ignored. See #StatusNotifierItem:compare-pixbufs for more.
  *
- * It is an error to call this function when the freeze count is zero.
+ * Since: 1.1.0
  */
 void
-status_notifier_item_thaw_tooltip (StatusNotifierItem      *sn)
+status_notifier_item_set_compare_pixbufs (StatusNotifierItem      *sn,
+                                          gboolean                 compare)
 {
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    g_return_if_fail (priv->tooltip_freeze > 0);
+    compare = !!compare;
+    if (priv->compare_pixbufs == compare)
+        return;
 
-    if (--priv->tooltip_freeze == 0)
-        dbus_notify (sn, PROP_TOOLTIP_TITLE);
+    priv->compare_pixbufs = compare;
+    notify (sn, PROP_COMPARE_PIXBUFS);
 }
 
 /**
- * status_notifier_item_set_tooltip:
+ * status_notifier_item_get_compare_pixbufs:
  * @sn: A #StatusNotifierItem
- * @icon_name: The icon name to be used for #STATUS_NOTIFIER_TOOLTIP_ICON
- * @title: The title of the tooltip
- * @body: The body of the tooltip
  *
- * This is an helper function that allows to set icon name, title and body of
- * the tooltip and then emit one DBus signal NewToolTip.
+ * Returns whether pixel data of pixbufs are compared. See
+ * #StatusNotifierItem:compare-pixbufs for more.
  *
- * It is equivalent to the following code:
- * <programlisting>
- * status_notifier_item_freeze_tooltip (sn);
- * status_notifier_item_set_from_icon_name (sn, STATUS_NOTIFIER_TOOLTIP_ICON, icon_name);
- * status_notifier_item_set_tooltip_title (sn, title);
- * status_notifier_item_set_tooltip_body (sn, body);
- * status_notifier_item_thaw_tooltip (sn);
- * </programlisting>
+ * Returns: Whether pixel data of pixbufs are compared
+ *
+ * Since: 1.1.0
  */
-void
-status_notifier_item_set_tooltip (StatusNotifierItem      *sn,
-                                  const gchar             *icon_name,
-                                  const gchar             *title,
-                                  const gchar             *body)
+gboolean
+status_notifier_item_get_compare_pixbufs (StatusNotifierItem      *sn)
 {
-    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
-    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
 
-    ++priv->tooltip_freeze;
-    status_notifier_item_set_from_icon_name (sn, STATUS_NOTIFIER_TOOLTIP_ICON, icon_name);
-    status_notifier_item_set_tooltip_title (sn, title);
-    status_notifier_item_set_tooltip_body (sn, body);
-    status_notifier_item_thaw_tooltip (sn);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->compare_pixbufs;
 }
 
-
 /**
- * status_notifier_item_set_tooltip_with_pixbuf:
+ * status_notifier_item_set_emit_properties_changed:
  * @sn: A #StatusNotifierItem
- * @pixbuf: The GdkPixbuf to be used for #STATUS_NOTIFIER_TOOLTIP_ICON
- * @title: The title of the tooltip
- * @body: The body of the tooltip
+ * @emit: Whether to emit DBus signal PropertiesChanged
  *
- * This is an helper function that allows to set icon, title and body of
- * the tooltip and then emit one DBus signal NewToolTip.
+ * Sets whether DBus signal PropertiesChanged, including the new values, is
+ * emitted along with the regular DBus signals. See
+ * #StatusNotifierItem:emit-properties-changed for more.
  *
- * It is equivalent to the following code:
- * <programlisting>
- * status_notifier_item_freeze_tooltip (sn);
- * status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_TOOLTIP_ICON, pixbuf);
- * status_notifier_item_set_tooltip_title (sn, title);
- * status_notifier_item_set_tooltip_body (sn, body);
- * status_notifier_item_thaw_tooltip (sn);
- * </programlisting>
+ * Since: 1.1.0
  */
 void
-status_notifier_item_set_tooltip_with_pixbuf (StatusNotifierItem    *sn,
-                                              GdkPixbuf             *pixbuf,
-                                              const gchar           *title,
-                                              const gchar           *body)
+status_notifier_item_set_emit_properties_changed (StatusNotifierItem      *sn,
+                                                  gboolean                 emit)
 {
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    ++priv->tooltip_freeze;
-    status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_TOOLTIP_ICON, pixbuf);
-    status_notifier_item_set_tooltip_title (sn, title);
+    emit = !!emit;
+    if (priv->emit_properties_changed == emit)
+        return;
+
+    priv->emit_properties_changed = emit;
+    notify (sn, PROP_EMIT_PROPERTIES_CHANGED);
+}
+
+/**
+ * status_notifier_item_get_emit_properties_changed:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns whether DBus signal PropertiesChanged is emitted. See
+ * #StatusNotifierItem:emit-properties-changed for more.
+ *
+ * Returns: Whether DBus signal PropertiesChanged is emitted
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_item_get_emit_properties_changed (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->emit_properties_changed;
+}
+
+/**
+ * status_notifier_item_set_properties_changed_max_size:
+ * @sn: A #StatusNotifierItem
+ * @max_size: Maximum size, in bytes
+ *
+ * Sets the maximum size of a value to be included in DBus signal
+ * PropertiesChanged. See #StatusNotifierItem:properties-changed-max-size
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_properties_changed_max_size (StatusNotifierItem      *sn,
+                                                      guint                    max_size)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->properties_changed_max_size == max_size)
+        return;
+
+    priv->properties_changed_max_size = max_size;
+    notify (sn, PROP_PROPERTIES_CHANGED_MAX_SIZE);
+}
+
+/**
+ * status_notifier_item_get_properties_changed_max_size:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the maximum size of a value to be included in DBus signal
+ * PropertiesChanged. See #StatusNotifierItem:properties-changed-max-size
+ *
+ * Returns: The maximum size, in bytes
+ *
+ * Since: 1.1.0
+ */
+guint
+status_notifier_item_get_properties_changed_max_size (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), 0);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->properties_changed_max_size;
+}
+
+static gint
+cmp_size (gconstpointer a, gconstpointer b)
+{
+    return *(const gint32 *) a - *(const gint32 *) b;
+}
+
+/**
+ * status_notifier_item_set_pixmap_sizes:
+ * @sn: A #StatusNotifierItem
+ * @sizes: (array length=n_sizes) (allow-none): The sizes to scale icons to
+ * @n_sizes: Number of elements in @sizes
+ *
+ * Sets the sizes (in pixels) icons set via #GdkPixbuf will be sent as to the
+ * hosts. Each icon is scaled once to each of those sizes (keeping its aspect
+ * ratio, the largest side being scaled to the given size), and all versions
+ * are then sent, so hosts can pick the one most appropriate to them without
+ * having to do any scaling themselves. E.g. 16, 22, 24, 32 and 48 should cover
+ * most panels, including on HiDPI screens.
+ *
+ * Use %NULL (or an @n_sizes of 0) to go back to the default, i.e. only send
+ * icons at their native size.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_pixmap_sizes (StatusNotifierItem      *sn,
+                                       const gint              *sizes,
+                                       guint                    n_sizes)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (sizes != NULL || n_sizes == 0);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    GArray *arr = NULL;
+    guint i;
+
+    for (i = 0; i < n_sizes; ++i)
+    {
+        gint32 size = sizes[i];
+
+        if (size <= 0)
+        {
+            g_warning ("Invalid pixmap size: %d", size);
+            continue;
+        }
+        if (!arr)
+            arr = g_array_sized_new (FALSE, FALSE, sizeof (gint32), n_sizes);
+        g_array_append_val (arr, size);
+    }
+    if (arr)
+    {
+        guint j;
+
+        /* sort & remove duplicates */
+        g_array_sort (arr, cmp_size);
+        for (i = j = 1; i < arr->len; ++i)
+            if (g_array_index (arr, gint32, i) != g_array_index (arr, gint32, j - 1))
+                g_array_index (arr, gint32, j++) = g_array_index (arr, gint32, i);
+        g_array_set_size (arr, j);
+    }
+
+    if ((!arr && !priv->pixmap_sizes) || (arr && priv->pixmap_sizes
+                && arr->len == priv->pixmap_sizes->len
+                && !memcmp (arr->data, priv->pixmap_sizes->data,
+                    arr->len * sizeof (gint32))))
+    {
+        if (arr)
+            g_array_unref (arr);
+        return;
+    }
+
+    if (priv->pixmap_sizes)
+        g_array_unref (priv->pixmap_sizes);
+    priv->pixmap_sizes = arr;
+
+    notify (sn, PROP_PIXMAP_SIZES);
+    for (i = 0; i < _NB_STATUS_NOTIFIER_ICONS; ++i)
+    {
+        if (!priv->icon[i].has_pixbuf)
+            continue;
+
+        if (priv->icon[i].pixmap)
+        {
+            g_variant_unref (priv->icon[i].pixmap);
+            priv->icon[i].pixmap = NULL;
+        }
+        dbus_invalidate_icon (sn, i);
+        /* (encoded & GIcon icons are only decoded/rendered when asked for) */
+        if (priv->pixmap_sizes && !priv->icon[i].data && !priv->icon[i].gicon)
+            get_icon_pixmap (sn, i);
+
+        dbus_notify (sn, prop_name_from_icon[i]);
+    }
+}
+
+/**
+ * status_notifier_item_get_pixmap_sizes:
+ * @sn: A #StatusNotifierItem
+ * @n_sizes: (out): Return location for the number of sizes
+ *
+ * Returns the sizes icons set via #GdkPixbuf are sent as. See
+ * status_notifier_item_set_pixmap_sizes() for more.
+ *
+ * Returns: (array length=n_sizes) (transfer full): A newly allocated array
+ * of sizes, or %NULL if icons are sent at their native size. Free with
+ * g_free() when done
+ *
+ * Since: 1.1.0
+ */
+gint *
+status_notifier_item_get_pixmap_sizes (StatusNotifierItem      *sn,
+                                       guint                   *n_sizes)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+    g_return_val_if_fail (n_sizes != NULL, NULL);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!priv->pixmap_sizes)
+    {
+        *n_sizes = 0;
+        return NULL;
+    }
+
+    gint *sizes;
+
+    *n_sizes = priv->pixmap_sizes->len;
+    sizes = g_new (gint, *n_sizes);
+    memcpy (sizes, priv->pixmap_sizes->data, *n_sizes * sizeof (gint));
+    return sizes;
+}
+
+/**
+ * status_notifier_item_set_raster_cache_size:
+ * @sn: A #StatusNotifierItem
+ * @size: Maximum size, in bytes
+ *
+ * Sets the budget of the cache of rendered #GIcon icons. See
+ * #StatusNotifierItem:raster-cache-size
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_raster_cache_size (StatusNotifierItem      *sn,
+                                            guint                    size)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->raster_cache_size == size)
+        return;
+
+    priv->raster_cache_size = size;
+    trim_raster_cache (sn);
+    notify (sn, PROP_RASTER_CACHE_SIZE);
+}
+
+/**
+ * status_notifier_item_get_raster_cache_size:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the budget of the cache of rendered #GIcon icons. See
+ * #StatusNotifierItem:raster-cache-size
+ *
+ * Returns: The maximum size of the cache, in bytes
+ *
+ * Since: 1.1.0
+ */
+guint
+status_notifier_item_get_raster_cache_size (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), 0);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->raster_cache_size;
+}
+
+/**
+ * status_notifier_item_begin_update:
+ * @sn: A #StatusNotifierItem
+ *
+ * Starts an update of @sn: until the matching call to
+ * status_notifier_item_commit_update() no notifications will be emitted,
+ * neither #GObject::notify signals nor DBus signals to the hosts.
+ *
+ * This allows to change multiple properties (e.g. icon, attention icon,
+ * status and title) atomically: hosts will not be notified of (and thus
+ * will not render) a half-updated item, and will only get the minimal set of
+ * signals once the update is committed, each signal being emitted at most
+ * once.
+ *
+ * Calls can be nested, notifications being emitted when the outermost update
+ * is committed. Every call to status_notifier_item_begin_update() must later
+ * be followed by a call to status_notifier_item_commit_update()
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_begin_update (StatusNotifierItem      *sn)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_BEGIN, 0, 0, NULL, NULL, NULL, NULL);
+        return;
+    }
+
+    if (priv->update_freeze++ == 0)
+        g_object_freeze_notify ((GObject *) sn);
+}
+
+/**
+ * status_notifier_item_commit_update:
+ * @sn: A #StatusNotifierItem
+ *
+ * Ends an update started with status_notifier_item_begin_update(). If this
+ * was the outermost update, all #GObject::notify signals are emitted (once
+ * per property changed), as well as DBus signals for hosts to refresh the
+ * properties that changed (once per signal), without waiting for the next
+ * main loop iteration, regardless of #StatusNotifierItem:coalesce-signals
+ *
+ * It is an error to call this function without a matching call to
+ * status_notifier_item_begin_update()
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_commit_update (StatusNotifierItem      *sn)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_COMMIT, 0, 0, NULL, NULL, NULL, NULL);
+        return;
+    }
+
+    g_return_if_fail (priv->update_freeze > 0);
+
+    if (--priv->update_freeze > 0)
+        return;
+
+    g_object_thaw_notify ((GObject *) sn);
+    dbus_flush (sn);
+}
+
+/**
+ * status_notifier_item_freeze_tooltip:
+ * @sn:A #StatusNotifierItem
+ *
+ * Increases the freeze count for tooltip on @sn. If the freeze count is
+ * non-zero, the emission of a DBus signal for StatusNotifierHost to refresh the
+ * ToolTip property will be blocked until the freeze count drops back to zero
+ * (via status_notifier_item_thaw_tooltip())
+ *
+ * This is to allow to set the different properties forming the tooltip (title,
+ * body and icon) without triggering a refresh afetr each change (as there is a
+ * single property ToolTip on the DBus item, with all data).
+ *
+ * Every call to status_notifier_item_freeze_tooltip() should later be followed by a
+ * call to status_notifier_item_thaw_tooltip()
+ */
+void
+status_notifier_item_freeze_tooltip (StatusNotifierItem      *sn)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_FREEZE_TOOLTIP, 0, 0, NULL, NULL, NULL, NULL);
+        return;
+    }
+    ++priv->tooltip_freeze;
+}
+
+/**
+ * status_notifier_item_thaw_tooltip:
+ * @sn: A #StatusNotifierItem
+ *
+ * Reverts the effect of a previous call to status_notifier_item_freeze_tooltip(). If
+ * the freeze count drops back to zero, a signal NewToolTip will be emitted on
+ * the DBus object for @sn, for StatusNotifierHost to refresh its ToolTip
+ * property.
+ *
+ * It is an error to call this function when the freeze count is zero.
+ */
+void
+status_notifier_item_thaw_tooltip (StatusNotifierItem      *sn)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_THAW_TOOLTIP, 0, 0, NULL, NULL, NULL, NULL);
+        return;
+    }
+
+    g_return_if_fail (priv->tooltip_freeze > 0);
+
+    if (--priv->tooltip_freeze == 0 && priv->tooltip_changed)
+    {
+        priv->tooltip_changed = FALSE;
+        dbus_notify (sn, PROP_TOOLTIP_TITLE);
+    }
+}
+
+/**
+ * status_notifier_item_set_tooltip:
+ * @sn: A #StatusNotifierItem
+ * @icon_name: The icon name to be used for #STATUS_NOTIFIER_TOOLTIP_ICON
+ * @title: The title of the tooltip
+ * @body: The body of the tooltip
+ *
+ * This is an helper function that allows to set icon name, title and body of
+ * the tooltip and then emit one DBus signal NewToolTip.
+ *
+ * It is equivalent to the following code:
+ * <programlisting>
+ * status_notifier_item_freeze_tooltip (sn);
+ * status_notifier_item_set_from_icon_name (sn, STATUS_NOTIFIER_TOOLTIP_ICON, icon_name);
+ * status_notifier_item_set_tooltip_title (sn, title);
+ * status_notifier_item_set_tooltip_body (sn, body);
+ * status_notifier_item_thaw_tooltip (sn);
+ * </programlisting>
+ */
+void
+status_notifier_item_set_tooltip (StatusNotifierItem      *sn,
+                                  const gchar             *icon_name,
+                                  const gchar             *title,
+                                  const gchar             *body)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_TOOLTIP, 0, 0, NULL, icon_name, title, body);
+        return;
+    }
+
+    ++priv->tooltip_freeze;
+    status_notifier_item_set_from_icon_name (sn, STATUS_NOTIFIER_TOOLTIP_ICON, icon_name);
+    status_notifier_item_set_tooltip_title (sn, title);
+    status_notifier_item_set_tooltip_body (sn, body);
+    status_notifier_item_thaw_tooltip (sn);
+}
+
+
+/**
+ * status_notifier_item_set_tooltip_with_pixbuf:
+ * @sn: A #StatusNotifierItem
+ * @pixbuf: The GdkPixbuf to be used for #STATUS_NOTIFIER_TOOLTIP_ICON
+ * @title: The title of the tooltip
+ * @body: The body of the tooltip
+ *
+ * This is an helper function that allows to set icon, title and body of
+ * the tooltip and then emit one DBus signal NewToolTip.
+ *
+ * It is equivalent to the following code:
+ * <programlisting>
+ * status_notifier_item_freeze_tooltip (sn);
+ * status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_TOOLTIP_ICON, pixbuf);
+ * status_notifier_item_set_tooltip_title (sn, title);
+ * status_notifier_item_set_tooltip_body (sn, body);
+ * status_notifier_item_thaw_tooltip (sn);
+ * </programlisting>
+ */
+void
+status_notifier_item_set_tooltip_with_pixbuf (StatusNotifierItem    *sn,
+                                              GdkPixbuf             *pixbuf,
+                                              const gchar           *title,
+                                              const gchar           *body)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_TOOLTIP_WITH_PIXBUF, 0, 0, pixbuf, NULL, title, body);
+        return;
+    }
+
+    ++priv->tooltip_freeze;
+    status_notifier_item_set_from_pixbuf (sn, STATUS_NOTIFIER_TOOLTIP_ICON, pixbuf);
+    status_notifier_item_set_tooltip_title (sn, title);
     status_notifier_item_set_tooltip_body (sn, body);
     status_notifier_item_thaw_tooltip (sn);
 }
 
-/**
- * status_notifier_item_set_tooltip_title:
- * @sn: A #StatusNotifierItem
- * @title: The tooltip title
- *
- * Sets the title of the tooltip
- *
- * The tooltip is composed of a title, a body, and an icon. Note that changing
- * any of these will trigger a DBus signal NewToolTip (for hosts to refresh DBus
- * property ToolTip), see status_notifier_item_freeze_tooltip() for changing more
- * than one and only emitting one DBus signal at the end.
- */
-void
-status_notifier_item_set_tooltip_title (StatusNotifierItem      *sn,
-                                        const gchar             *title)
+/**
+ * status_notifier_item_set_tooltip_title:
+ * @sn: A #StatusNotifierItem
+ * @title: The tooltip title
+ *
+ * Sets the title of the tooltip
+ *
+ * The tooltip is composed of a title, a body, and an icon. Note that changing
+ * any of these will trigger a DBus signal NewToolTip (for hosts to refresh DBus
+ * property ToolTip), see status_notifier_item_freeze_tooltip() for changing more
+ * than one and only emitting one DBus signal at the end.
+ */
+void
+status_notifier_item_set_tooltip_title (StatusNotifierItem      *sn,
+                                        const gchar             *title)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_TOOLTIP_TITLE, 0, 0, NULL, title, NULL, NULL);
+        return;
+    }
+
+    if (!g_strcmp0 (priv->tooltip_title, title))
+        return;
+
+    g_free (priv->tooltip_title);
+    priv->tooltip_title = g_strdup (title);
+    dbus_invalidate (sn, DBUS_PROP_TOOLTIP);
+
+    notify (sn, PROP_TOOLTIP_TITLE);
+    dbus_notify (sn, PROP_TOOLTIP_TITLE);
+}
+
+/**
+ * status_notifier_item_get_tooltip_title:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the tooltip title
+ *
+ * Returns: A newly allocated string of the tooltip title, use g_free() when
+ * done
+ */
+gchar *
+status_notifier_item_get_tooltip_title (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_strdup (priv->tooltip_title);
+}
+
+/**
+ * status_notifier_item_set_tooltip_body:
+ * @sn: A #StatusNotifierItem
+ * @body: The tooltip body
+ *
+ * Sets the body of the tooltip
+ *
+ * This body can contain some markup, which consists of a small subset of XHTML.
+ * See http://www.notmart.org/misc/statusnotifieritem/markup.html for more.
+ *
+ * The tooltip is composed of a title, a body, and an icon. Note that changing
+ * any of these will trigger a DBus signal NewToolTip (for hosts to refresh DBus
+ * property ToolTip), see status_notifier_item_freeze_tooltip() for changing more
+ * than one and only emitting one DBus signal at the end.
+ */
+void
+status_notifier_item_set_tooltip_body (StatusNotifierItem      *sn,
+                                       const gchar             *body)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_TOOLTIP_BODY, 0, 0, NULL, body, NULL, NULL);
+        return;
+    }
+
+    if (!g_strcmp0 (priv->tooltip_body, body))
+        return;
+
+    g_free (priv->tooltip_body);
+    priv->tooltip_body = g_strdup (body);
+    dbus_invalidate (sn, DBUS_PROP_TOOLTIP);
+
+    notify (sn, PROP_TOOLTIP_BODY);
+    dbus_notify (sn, PROP_TOOLTIP_BODY);
+}
+
+/**
+ * status_notifier_item_get_tooltip_body:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the tooltip body
+ *
+ * Returns: A newly allocated string of the tooltip body, use g_free() when done
+ */
+gchar *
+status_notifier_item_get_tooltip_body (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_strdup (priv->tooltip_body);
+}
+
+static gboolean
+fill_submenu (GMenuModel *submenu, gpointer data)
+{
+    StatusNotifierItem *sn = data;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Provider *provider;
+
+    if (!priv->providers)
+        return FALSE;
+    provider = g_hash_table_lookup (priv->providers, submenu);
+    if (!provider || provider->filled)
+        return FALSE;
+
+    /* set first, in case the provider invalidates it */
+    provider->filled = TRUE;
+    g_menu_remove_all ((GMenu *) submenu);
+    provider->func (sn, (GMenu *) submenu, provider->data);
+    return TRUE;
+}
+
+static void
+free_provider (gpointer data)
+{
+    Provider *provider = data;
+
+    if (provider->destroy)
+        provider->destroy (provider->data);
+    g_slice_free (Provider, provider);
+}
+
+/**
+ * status_notifier_item_set_menu_model:
+ * @sn: A #StatusNotifierItem
+ * @model: (allow-none): The #GMenuModel to export as context menu, or %NULL
+ * @actions: (allow-none): The #GActionGroup with the actions of @model
+ *
+ * Exports @model as context menu via DBus, like
+ * status_notifier_item_set_context_menu() but without using libdbusmenu nor
+ * GTK, and thus available even if dbusmenu support wasn't enabled during
+ * compilation.
+ *
+ * Items of @model activate the action named by their
+ * %G_MENU_ATTRIBUTE_ACTION attribute in @actions (with their
+ * %G_MENU_ATTRIBUTE_TARGET if any); names with a prefix (e.g. "app.quit") are
+ * also looked up without it. Items are disabled (or hidden, as per their
+ * "hidden-when" attribute) when their action is, and stateful actions are
+ * shown as check or radio items.
+ *
+ * Changes to @model or @actions are reflected over DBus as they happen, only
+ * for what changed.
+ *
+ * Setting a model unsets any context menu set via
+ * status_notifier_item_set_context_menu() and vice versa, and as with it no
+ * #StatusNotifierItem::context_menu signals will be emitted while a menu is
+ * set. If @model is %NULL any current model will be unset.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_menu_model (StatusNotifierItem      *sn,
+                                     GMenuModel              *model,
+                                     GActionGroup            *actions)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (!model || G_IS_MENU_MODEL (model));
+    g_return_if_fail (!actions || G_IS_ACTION_GROUP (actions));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->menu_model)
+    {
+        sn_menu_free (priv->menu_model);
+        priv->menu_model = NULL;
+    }
+    dbus_invalidate (sn, DBUS_PROP_MENU);
+    if (!model)
+        return;
+
+    status_notifier_item_set_context_menu (sn, NULL);
+    priv->menu_model = sn_menu_new (model, actions, priv->context);
+    sn_menu_set_fill_func (priv->menu_model, fill_submenu, sn);
+    if (priv->dbus_conn)
+        export_menu_model (sn);
+}
+
+/**
+ * status_notifier_item_set_submenu_provider:
+ * @sn: A #StatusNotifierItem
+ * @submenu: A #GMenu linked as submenu in the model set via
+ * status_notifier_item_set_menu_model()
+ * @provider: (allow-none): The function to fill @submenu, or %NULL
+ * @user_data: Data for @provider
+ * @destroy: (allow-none): Function to free @user_data when @provider is
+ * replaced or removed, or @sn finalized
+ *
+ * Sets @provider as the function to fill @submenu, which should be left empty
+ * in the model. Its items are then only created when a host is about to show
+ * it (i.e. calls AboutToShow for it), which makes setting up a menu with large
+ * submenus rarely opened (e.g. bookmarks, devices) cost only what's actually
+ * shown.
+ *
+ * Once filled, @submenu is kept as is (and changes to it reflected over DBus
+ * as usual) until status_notifier_item_invalidate_submenu() is called, after
+ * which it will be emptied and filled again the next time it's about to be
+ * shown.
+ *
+ * If @provider is %NULL, any provider for @submenu is removed, its current
+ * items remaining.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_submenu_provider (StatusNotifierItem      *sn,
+                                           GMenu                   *submenu,
+                                           StatusNotifierSubmenuProvider provider,
+                                           gpointer                 user_data,
+                                           GDestroyNotify           destroy)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (G_IS_MENU (submenu));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Provider *p;
+
+    if (!provider)
+    {
+        if (priv->providers)
+            g_hash_table_remove (priv->providers, submenu);
+        return;
+    }
+
+    if (!priv->providers)
+        priv->providers = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                g_object_unref, free_provider);
+
+    p = g_slice_new (Provider);
+    p->func = provider;
+    p->data = user_data;
+    p->destroy = destroy;
+    p->filled = FALSE;
+    g_hash_table_replace (priv->providers, g_object_ref (submenu), p);
+}
+
+/**
+ * status_notifier_item_invalidate_submenu:
+ * @sn: A #StatusNotifierItem
+ * @submenu: A #GMenu with a provider
+ *
+ * Marks @submenu as needing to be filled again by its provider, which will
+ * happen the next time a host is about to show it. See
+ * status_notifier_item_set_submenu_provider()
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_invalidate_submenu (StatusNotifierItem      *sn,
+                                         GMenu                   *submenu)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (G_IS_MENU (submenu));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Provider *provider = NULL;
+
+    if (priv->providers)
+        provider = g_hash_table_lookup (priv->providers, submenu);
+    g_return_if_fail (provider != NULL);
+
+    provider->filled = FALSE;
+}
+
+/**
+ * status_notifier_item_get_menu_model:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns the #GMenuModel set as context menu, or %NULL. See
+ * status_notifier_item_set_menu_model()
+ *
+ * Returns: (transfer none): #GMenuModel or %NULL
+ *
+ * Since: 1.1.0
+ */
+GMenuModel *
+status_notifier_item_get_menu_model (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return (priv->menu_model) ? sn_menu_get_model (priv->menu_model) : NULL;
+}
+
+static GVariant *
+dbus_prop_id (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_variant_new ("s", priv->id);
+}
+
+static GVariant *
+dbus_prop_category (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    const gchar *const s_category[] = {
+        "ApplicationStatus",
+        "Communications",
+        "SystemServices",
+        "Hardware"
+    };
+    return g_variant_new ("s", s_category[priv->category]);
+}
+
+static GVariant *
+dbus_prop_title (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_variant_new ("s", (priv->title) ? priv->title : "");
+}
+
+static GVariant *
+dbus_prop_status (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    const gchar *const s_status[] = {
+        "Passive",
+        "Active",
+        "NeedsAttention"
+    };
+    return g_variant_new ("s", s_status[priv->status]);
+}
+
+static GVariant *
+dbus_prop_window_id (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_variant_new ("i", priv->window_id);
+}
+
+static GVariant *
+dbus_prop_icon_name (StatusNotifierItem *sn, guint icon)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_variant_new ("s", (!priv->icon[icon].has_pixbuf)
+            ? ((priv->icon[icon].icon_name) ? priv->icon[icon].icon_name : "")
+            : "");
+}
+
+static GVariant *
+dbus_prop_icon_pixmap (StatusNotifierItem *sn, guint icon)
+{
+    GVariant *pixmap;
+
+    pixmap = get_icon_pixmap (sn, icon);
+    if (!pixmap)
+        return g_variant_new ("a(iiay)", NULL);
+    return g_variant_ref (pixmap);
+}
+
+static GVariant *
+dbus_prop_attention_movie_name (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_variant_new ("s", (priv->attention_movie_name)
+            ? priv->attention_movie_name : "");
+}
+
+static GVariant *
+dbus_prop_tooltip (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GVariant *pixmap;
+
+    if (!priv->icon[STATUS_NOTIFIER_TOOLTIP_ICON].has_pixbuf)
+        return g_variant_new ("(sa(iiay)ss)",
+                (priv->icon[STATUS_NOTIFIER_TOOLTIP_ICON].icon_name)
+                ? priv->icon[STATUS_NOTIFIER_TOOLTIP_ICON].icon_name : "",
+                NULL,
+                (priv->tooltip_title) ? priv->tooltip_title : "",
+                (priv->tooltip_body) ? priv->tooltip_body : "");
+
+    /* (NULL if it couldn't be decoded) */
+    pixmap = get_icon_pixmap (sn, STATUS_NOTIFIER_TOOLTIP_ICON);
+    return g_variant_new ("(s@a(iiay)ss)",
+            "",
+            (pixmap) ? pixmap : g_variant_new ("a(iiay)", NULL),
+            (priv->tooltip_title) ? priv->tooltip_title : "",
+            (priv->tooltip_body) ? priv->tooltip_body : "");
+}
+
+static GVariant *
+dbus_prop_item_is_menu (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return g_variant_new ("b", priv->item_is_menu);
+}
+
+static GVariant *
+dbus_prop_menu (StatusNotifierItem *sn, guint arg _UNUSED_)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->menu_model && sn_menu_get_path (priv->menu_model))
+        return g_variant_new ("o", sn_menu_get_path (priv->menu_model));
+#if USE_DBUSMENU
+    if (priv->menu_service != NULL)
+    {
+        GValue strval = { 0 };
+        GVariant *var;
+
+        g_value_init (&strval, G_TYPE_STRING);
+        g_object_get_property (G_OBJECT (priv->menu_service),
+                DBUSMENU_SERVER_PROP_DBUS_OBJECT, &strval);
+        var = g_variant_new ("o", g_value_get_string (&strval));
+        g_value_unset (&strval);
+        return var;
+    }
+#endif
+    return g_variant_new ("o", "/NO_DBUSMENU");
+}
+
+/* DBus properties of the item, in the order of item_xml */
+static const struct {
+    const gchar *name;
+    GVariant *(*get) (StatusNotifierItem *sn, guint arg);
+    guint arg;
+} dbus_props[NB_DBUS_PROPS] = {
+    { "Id",                     dbus_prop_id,               0 },
+    { "Category",               dbus_prop_category,         0 },
+    { "Title",                  dbus_prop_title,            0 },
+    { "Status",                 dbus_prop_status,           0 },
+    { "WindowId",               dbus_prop_window_id,        0 },
+    { "IconName",               dbus_prop_icon_name,        STATUS_NOTIFIER_ICON },
+    { "IconPixmap",             dbus_prop_icon_pixmap,      STATUS_NOTIFIER_ICON },
+    { "OverlayIconName",        dbus_prop_icon_name,        STATUS_NOTIFIER_OVERLAY_ICON },
+    { "OverlayIconPixmap",      dbus_prop_icon_pixmap,      STATUS_NOTIFIER_OVERLAY_ICON },
+    { "AttentionIconName",      dbus_prop_icon_name,        STATUS_NOTIFIER_ATTENTION_ICON },
+    { "AttentionIconPixmap",    dbus_prop_icon_pixmap,      STATUS_NOTIFIER_ATTENTION_ICON },
+    { "AttentionMovieName",     dbus_prop_attention_movie_name, 0 },
+    { "ToolTip",                dbus_prop_tooltip,          0 },
+    { "ItemIsMenu",             dbus_prop_item_is_menu,     0 },
+    { "Menu",                   dbus_prop_menu,             0 }
+};
+
+/* DBus methods of the item, with the signal each one triggers */
+static const struct {
+    const gchar *name;
+    guint signal;
+} dbus_methods[NB_DBUS_METHODS] = {
+    { "ContextMenu",            SIGNAL_CONTEXT_MENU },
+    { "Activate",               SIGNAL_ACTIVATE },
+    { "SecondaryActivate",      SIGNAL_SECONDARY_ACTIVATE },
+    { "Scroll",                 SIGNAL_SCROLL }
+};
+
+/* maps names of DBus properties & methods to their index (+1, since NULL
+ * means not found) in dbus_props and dbus_methods respectively. Built once
+ * and shared by all items. */
+static GHashTable *
+get_dispatch_table (gboolean methods)
+{
+    static GHashTable *tables[2];
+
+    if (g_once_init_enter (&tables[methods]))
+    {
+        GHashTable *table;
+        guint i;
+
+        table = g_hash_table_new (g_str_hash, g_str_equal);
+        if (methods)
+            for (i = 0; i < NB_DBUS_METHODS; ++i)
+                g_hash_table_insert (table, (gpointer) dbus_methods[i].name,
+                        GUINT_TO_POINTER (i + 1));
+        else
+            for (i = 0; i < NB_DBUS_PROPS; ++i)
+                g_hash_table_insert (table, (gpointer) dbus_props[i].name,
+                        GUINT_TO_POINTER (i + 1));
+
+        g_once_init_leave (&tables[methods], table);
+    }
+
+    return tables[methods];
+}
+
+/* returns the value of DBus property @prop, only rebuilt when invalidated.
+ * The returned value is owned by @sn */
+static GVariant *
+get_dbus_value (StatusNotifierItem *sn, guint prop)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->dbus_values[prop] && !(priv->dbus_dirty & (1u << prop)))
+    {
+        ++priv->value_cache_hits;
+        return priv->dbus_values[prop];
+    }
+    ++priv->value_cache_misses;
+
+    if (priv->dbus_values[prop])
+        g_variant_unref (priv->dbus_values[prop]);
+    priv->dbus_values[prop] = g_variant_ref_sink (
+            dbus_props[prop].get (sn, dbus_props[prop].arg));
+    priv->dbus_dirty &= ~(1u << prop);
+    /* the snapshot holds the old value */
+    if (priv->dbus_snapshot)
+    {
+        g_variant_unref (priv->dbus_snapshot);
+        priv->dbus_snapshot = NULL;
+    }
+
+    return priv->dbus_values[prop];
+}
+
+/* returns all DBus properties as a{sv}, as replied to GetAll. Only values
+ * that were invalidated are rebuilt, and as long as none are the same
+ * snapshot is shared by all replies. The returned value is owned by @sn */
+static GVariant *
+get_dbus_snapshot (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GVariantBuilder builder;
+    guint i;
+
+    if (priv->dbus_snapshot && priv->dbus_dirty == 0)
+        return priv->dbus_snapshot;
+
+    /* first refresh invalidated values, which drops the snapshot */
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+        get_dbus_value (sn, i);
+    if (priv->dbus_snapshot)
+        return priv->dbus_snapshot;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+        g_variant_builder_add (&builder, "{sv}",
+                dbus_props[i].name, priv->dbus_values[i]);
+    priv->dbus_snapshot = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+    return priv->dbus_snapshot;
+}
+
+/* emits PropertiesChanged for the DBus properties refreshed by @signals (bitmask
+ * of 1 << DBUS_SIGNAL_*), with their new values unless larger than
+ * properties_changed_max_size bytes, then only listed as invalidated */
+static void
+dbus_emit_properties_changed (StatusNotifierItem *sn, guint signals)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    static const guint props[NB_DBUS_SIGNALS][2] = {
+        { DBUS_PROP_TITLE, NB_DBUS_PROPS },
+        { DBUS_PROP_ICON_NAME, DBUS_PROP_ICON_PIXMAP },
+        { DBUS_PROP_ATTENTION_ICON_NAME, DBUS_PROP_ATTENTION_ICON_PIXMAP },
+        { DBUS_PROP_OVERLAY_ICON_NAME, DBUS_PROP_OVERLAY_ICON_PIXMAP },
+        { DBUS_PROP_TOOLTIP, NB_DBUS_PROPS },
+        { DBUS_PROP_STATUS, NB_DBUS_PROPS }
+    };
+    GVariantBuilder changed;
+    GVariantBuilder invalidated;
+    guint signal, i;
+
+    g_variant_builder_init (&changed, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_init (&invalidated, G_VARIANT_TYPE_STRING_ARRAY);
+    for (signal = 0; signal < NB_DBUS_SIGNALS; ++signal)
+    {
+        if (!(signals & (1 << signal)))
+            continue;
+
+        for (i = 0; i < G_N_ELEMENTS (props[signal]); ++i)
+        {
+            guint prop = props[signal][i];
+            GVariant *value;
+
+            if (prop == NB_DBUS_PROPS)
+                continue;
+
+            value = get_dbus_value (sn, prop);
+            if (g_variant_get_size (value) > priv->properties_changed_max_size)
+                g_variant_builder_add (&invalidated, "s", dbus_props[prop].name);
+            else
+                g_variant_builder_add (&changed, "{sv}",
+                        dbus_props[prop].name, value);
+        }
+    }
+
+    ++priv->stats_properties_changed;
+    g_dbus_connection_emit_signal (priv->dbus_conn,
+            NULL,
+            object_path (priv),
+            "org.freedesktop.DBus.Properties",
+            "PropertiesChanged",
+            g_variant_new ("(sa{sv}as)", ITEM_INTERFACE, &changed, &invalidated),
+            NULL);
+}
+
+/* Since we don't provide a get_property in the vtable, GDBus sends us calls of
+ * org.freedesktop.DBus.Properties (after validating them), which allows to
+ * answer GetAll in one go */
+static void
+properties_call (StatusNotifierItem     *sn,
+                 const gchar            *method,
+                 GVariant               *params,
+                 GDBusMethodInvocation  *invocation)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!g_strcmp0 (method, "GetAll"))
+    {
+        ++priv->stats_get_all;
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(@a{sv})", get_dbus_snapshot (sn)));
+    }
+    else if (!g_strcmp0 (method, "Get"))
+    {
+        const gchar *property;
+        guint prop;
+
+        g_variant_get (params, "(&s&s)", NULL, &property);
+        prop = GPOINTER_TO_UINT (g_hash_table_lookup (get_dispatch_table (FALSE),
+                    property));
+        /* should never happen, GDBus checks against the introspection data */
+        if (G_UNLIKELY (prop == 0))
+        {
+            g_dbus_method_invocation_return_error (invocation,
+                    G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "No such property: %s", property);
+            return;
+        }
+
+        ++priv->stats_get[prop - 1];
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(v)", get_dbus_value (sn, prop - 1)));
+    }
+    else
+        /* Set, refused by GDBus since all properties are read-only */
+        g_dbus_method_invocation_return_error (invocation,
+                G_DBUS_ERROR, G_DBUS_ERROR_PROPERTY_READ_ONLY,
+                "Properties are read-only");
+}
+
+/* signal of a method call already replied to, see
+ * StatusNotifierItem:reply-first */
+typedef struct
+{
+    StatusNotifierItem *sn;
+    guint signal;
+    /* x & y, or delta & orientation for scroll */
+    gint arg1;
+    gint arg2;
+} MethodSignal;
+
+static gboolean
+emit_method_signal (gpointer data)
+{
+    MethodSignal *ms = data;
+    gboolean ret;
+
+    g_signal_emit (ms->sn, status_notifier_item_signals[ms->signal], 0,
+            ms->arg1, ms->arg2, &ret);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+free_method_signal (gpointer data)
+{
+    MethodSignal *ms = data;
+
+    g_object_unref (ms->sn);
+    g_slice_free (MethodSignal, ms);
+}
+
+static void
+method_call (GDBusConnection        *conn _UNUSED_,
+             const gchar            *sender _UNUSED_,
+             const gchar            *object _UNUSED_,
+             const gchar            *interface,
+             const gchar            *method,
+             GVariant               *params,
+             GDBusMethodInvocation  *invocation,
+             gpointer                data)
+{
+    StatusNotifierItem *sn = (StatusNotifierItem *) data;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    guint m, signal;
+    gint arg1, arg2;
+    gboolean ret;
+
+    if (!g_strcmp0 (interface, "org.freedesktop.DBus.Properties"))
+    {
+        properties_call (sn, method, params, invocation);
+        return;
+    }
+
+    m = GPOINTER_TO_UINT (g_hash_table_lookup (get_dispatch_table (TRUE),
+                method));
+    /* should never happen, GDBus checks against the introspection data */
+    g_return_if_fail (m > 0);
+    --m;
+    ++priv->stats_methods[m];
+
+    signal = dbus_methods[m].signal;
+    if (m == DBUS_METHOD_SCROLL)
+    {
+        gchar *s_orientation;
+
+        g_variant_get (params, "(is)", &arg1, &s_orientation);
+        if (!g_ascii_strcasecmp (s_orientation, "vertical"))
+            arg2 = STATUS_NOTIFIER_SCROLL_ORIENTATION_VERTICAL;
+        else
+            arg2 = STATUS_NOTIFIER_SCROLL_ORIENTATION_HORIZONTAL;
+        g_free (s_orientation);
+    }
+    else
+        g_variant_get (params, "(ii)", &arg1, &arg2);
+
+    if (priv->reply_first)
+    {
+        MethodSignal *ms;
+
+        g_dbus_method_invocation_return_value (invocation, NULL);
+
+        ms = g_slice_new (MethodSignal);
+        ms->sn = g_object_ref (sn);
+        ms->signal = signal;
+        ms->arg1 = arg1;
+        ms->arg2 = arg2;
+        idle_add (sn, G_PRIORITY_DEFAULT, emit_method_signal, ms,
+                free_method_signal);
+        return;
+    }
+
+    g_signal_emit (sn, status_notifier_item_signals[signal], 0, arg1, arg2, &ret);
+    g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+debug_method_call (GDBusConnection        *conn _UNUSED_,
+                   const gchar            *sender _UNUSED_,
+                   const gchar            *object _UNUSED_,
+                   const gchar            *interface,
+                   const gchar            *method,
+                   GVariant               *params _UNUSED_,
+                   GDBusMethodInvocation  *invocation,
+                   gpointer                data)
+{
+    GVariant *stats;
+
+    /* org.freedesktop.DBus.Properties calls are routed here as well (there's
+     * no get_property); the interface has no properties */
+    if (g_strcmp0 (interface, DEBUG_INTERFACE) != 0)
+    {
+        if (!g_strcmp0 (method, "GetAll"))
+            g_dbus_method_invocation_return_value (invocation,
+                    g_variant_new ("(@a{sv})",
+                        g_variant_new_array (G_VARIANT_TYPE ("{sv}"), NULL, 0)));
+        else
+            g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                    G_DBUS_ERROR_UNKNOWN_PROPERTY, "No such property");
+        return;
+    }
+    else if (g_strcmp0 (method, "GetStats") != 0)
+    {
+        g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR,
+                G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s", method);
+        return;
+    }
+
+    stats = status_notifier_item_get_stats ((StatusNotifierItem *) data);
+    g_dbus_method_invocation_return_value (invocation,
+            g_variant_new ("(@a{sv})", stats));
+    g_variant_unref (stats);
+}
+
+static const GDBusInterfaceVTable debug_vtable = {
+    .method_call = debug_method_call
+};
+
+static const GDBusInterfaceVTable item_vtable = {
+    .method_call = method_call,
+    .get_property = NULL, /* see properties_call() */
+    .set_property = NULL
+};
+
+/* scales @pixbuf so its largest side is @size, keeping aspect ratio */
+static GdkPixbuf *
+scale_pixbuf (GdkPixbuf *pixbuf, gint size)
+{
+    gint width, height;
+    gint w, h;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    if (width >= height)
+    {
+        w = size;
+        h = MAX (1, height * size / width);
+    }
+    else
+    {
+        w = MAX (1, width * size / height);
+        h = size;
+    }
+
+    if (w == width && h == height)
+        return g_object_ref (pixbuf);
+    return gdk_pixbuf_scale_simple (pixbuf, w, h, GDK_INTERP_HYPER);
+}
+
+/* loads @gicon rendered at @size (its largest side), or at its native size if
+ * @size is -1 */
+static GdkPixbuf *
+load_gicon (GIcon *gicon, gint size, GError **error)
+{
+    GInputStream *stream;
+    GdkPixbuf *pixbuf;
+
+    stream = g_loadable_icon_load (G_LOADABLE_ICON (gicon), MAX (size, 0),
+            NULL, NULL, error);
+    if (!stream)
+        return NULL;
+    if (size > 0)
+        pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream, size, size, TRUE,
+                NULL, error);
+    else
+        pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, error);
+    g_object_unref (stream);
+
+    return pixbuf;
+}
+
+/* returns the pixbuf of @icon, decoding (or loading) it if needed, or NULL
+ * if it doesn't have one. The returned value is owned by @sn */
+static GdkPixbuf *
+get_icon_pixbuf (StatusNotifierItem *sn, StatusNotifierIcon icon)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GdkPixbufLoader *loader;
+    GError *error = NULL;
+    gsize len;
+    const guchar *data;
+
+    if (!priv->icon[icon].has_pixbuf)
+        return NULL;
+    if (priv->icon[icon].pixbuf)
+        return priv->icon[icon].pixbuf;
+
+    if (priv->icon[icon].gicon)
+    {
+        priv->icon[icon].pixbuf = load_gicon (priv->icon[icon].gicon, -1, &error);
+        if (!priv->icon[icon].pixbuf)
+        {
+            g_warning ("Failed to load icon: %s", error->message);
+            g_error_free (error);
+        }
+        return priv->icon[icon].pixbuf;
+    }
+    if (!priv->icon[icon].data)
+        return NULL;
+
+    loader = gdk_pixbuf_loader_new ();
+    data = g_bytes_get_data (priv->icon[icon].data, &len);
+    if (!gdk_pixbuf_loader_write (loader, data, len, &error))
+        /* (must still be closed) */
+        gdk_pixbuf_loader_close (loader, NULL);
+    else if (gdk_pixbuf_loader_close (loader, &error))
+        priv->icon[icon].pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+
+    if (priv->icon[icon].pixbuf)
+        g_object_ref (priv->icon[icon].pixbuf);
+    else
+    {
+        g_warning ("Failed to decode icon: %s",
+                (error) ? error->message : "no image");
+        g_clear_error (&error);
+        /* so it isn't tried again */
+        g_bytes_unref (priv->icon[icon].data);
+        priv->icon[icon].data = NULL;
+    }
+    g_object_unref (loader);
+
+    return priv->icon[icon].pixbuf;
+}
+
+static void
+free_raster (Raster *raster)
+{
+    g_variant_unref (raster->entry);
+    g_slice_free (Raster, raster);
+}
+
+/* whether @raster is part of the current pixmap of its icon, which then
+ * holds a ref on it anyway */
+static gboolean
+raster_in_use (StatusNotifierItemPrivate *priv, Raster *raster)
+{
+    guint i;
+
+    if (!priv->icon[raster->icon].pixmap)
+        return FALSE;
+    if (!priv->pixmap_sizes)
+        return raster->size == -1;
+    for (i = 0; i < priv->pixmap_sizes->len; ++i)
+        if (g_array_index (priv->pixmap_sizes, gint32, i) == raster->size)
+            return TRUE;
+    return FALSE;
+}
+
+/* drops least recently used rasters not in use until the cache fits its
+ * budget (or only has rasters in use left) */
+static void
+trim_raster_cache (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GList *l, *prev;
+
+    for (l = priv->raster_cache.tail;
+            l && priv->raster_cache_bytes > priv->raster_cache_size;
+            l = prev)
+    {
+        Raster *raster = l->data;
+
+        prev = l->prev;
+        if (raster_in_use (priv, raster))
+            continue;
+        priv->raster_cache_bytes -= g_variant_get_size (raster->entry);
+        free_raster (raster);
+        g_queue_delete_link (&priv->raster_cache, l);
+    }
+}
+
+/* drops all rasters of @icon from the cache */
+static void
+clear_rasters (StatusNotifierItem *sn, StatusNotifierIcon icon)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GList *l, *next;
+
+    for (l = priv->raster_cache.head; l; l = next)
+    {
+        Raster *raster = l->data;
+
+        next = l->next;
+        if (raster->icon != icon)
+            continue;
+        priv->raster_cache_bytes -= g_variant_get_size (raster->entry);
+        free_raster (raster);
+        g_queue_delete_link (&priv->raster_cache, l);
+    }
+}
+
+/* returns the (iiay) of the GIcon of @icon at @size, from the raster cache
+ * if possible, or NULL if it couldn't be loaded. The returned value is owned
+ * by the cache */
+static GVariant *
+get_icon_raster (StatusNotifierItem *sn, StatusNotifierIcon icon, gint32 size)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GError *error = NULL;
+    GdkPixbuf *pixbuf;
+    Raster *raster;
+    GList *l;
+
+    for (l = priv->raster_cache.head; l; l = l->next)
+    {
+        raster = l->data;
+        if (raster->icon == icon && raster->size == size)
+        {
+            ++priv->raster_cache_hits;
+            /* most recently used go first */
+            g_queue_unlink (&priv->raster_cache, l);
+            g_queue_push_head_link (&priv->raster_cache, l);
+            return raster->entry;
+        }
+    }
+    ++priv->raster_cache_misses;
+
+    pixbuf = load_gicon (priv->icon[icon].gicon, size, &error);
+    if (!pixbuf)
+    {
+        g_warning ("Failed to load icon: %s", error->message);
+        g_error_free (error);
+        return NULL;
+    }
+
+    raster = g_slice_new (Raster);
+    raster->icon = icon;
+    raster->size = size;
+    raster->entry = g_variant_ref_sink (sn_pixmap_new_from_pixbuf (pixbuf));
+    g_object_unref (pixbuf);
+    g_queue_push_head (&priv->raster_cache, raster);
+    priv->raster_cache_bytes += g_variant_get_size (raster->entry);
+
+    return raster->entry;
+}
+
+/* returns the a(iiay) of the GIcon of @icon, at all pixmap sizes, or NULL if
+ * it couldn't be loaded */
+static GVariant *
+build_gicon_pixmap (StatusNotifierItem *sn, StatusNotifierIcon icon)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GVariantBuilder builder;
+    GVariant *entry;
+    guint n = (priv->pixmap_sizes) ? priv->pixmap_sizes->len : 1;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(iiay)"));
+    for (i = 0; i < n; ++i)
+    {
+        entry = get_icon_raster (sn, icon, (priv->pixmap_sizes)
+                ? g_array_index (priv->pixmap_sizes, gint32, i) : -1);
+        if (!entry)
+        {
+            g_variant_builder_clear (&builder);
+            /* so it isn't tried again */
+            g_object_unref (priv->icon[icon].gicon);
+            priv->icon[icon].gicon = NULL;
+            clear_rasters (sn, icon);
+            return NULL;
+        }
+        g_variant_builder_add_value (&builder, entry);
+    }
+
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/* returns the (cached) DBus representation of the pixbuf of @icon, or NULL
+ * if it doesn't have one. The returned value is owned by @sn */
+static GVariant *
+get_icon_pixmap (StatusNotifierItem *sn, StatusNotifierIcon icon)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GdkPixbuf *pixbuf;
+    GVariant *entry;
+
+    if (!priv->icon[icon].has_pixbuf)
+        return NULL;
+
+    if (priv->icon[icon].pixmap)
+    {
+        ++priv->pixmap_cache_hits;
+        return priv->icon[icon].pixmap;
+    }
+
+    if (priv->icon[icon].gicon)
+    {
+        priv->icon[icon].pixmap = build_gicon_pixmap (sn, icon);
+        if (!priv->icon[icon].pixmap)
+            return NULL;
+        ++priv->pixmap_cache_misses;
+        priv->pixmap_bytes += g_variant_get_size (priv->icon[icon].pixmap);
+        /* (only now, so the rasters just used are known to be in use) */
+        trim_raster_cache (sn);
+        return priv->icon[icon].pixmap;
+    }
+
+    pixbuf = get_icon_pixbuf (sn, icon);
+    if (!pixbuf)
+        return NULL;
+    ++priv->pixmap_cache_misses;
+
+    if (!priv->pixmap_sizes)
+    {
+        entry = sn_pixmap_new_from_pixbuf (pixbuf);
+        priv->icon[icon].pixmap = g_variant_ref_sink (g_variant_new_array (
+                    G_VARIANT_TYPE ("(iiay)"), &entry, 1));
+    }
+    else
+    {
+        GVariantBuilder builder;
+        guint i;
+
+        g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(iiay)"));
+        for (i = 0; i < priv->pixmap_sizes->len; ++i)
+        {
+            GdkPixbuf *scaled;
+
+            scaled = scale_pixbuf (pixbuf,
+                    g_array_index (priv->pixmap_sizes, gint32, i));
+            entry = sn_pixmap_new_from_pixbuf (scaled);
+            g_object_unref (scaled);
+            g_variant_builder_add_value (&builder, entry);
+        }
+        priv->icon[icon].pixmap = g_variant_ref_sink (g_variant_builder_end (&builder));
+    }
+    priv->pixmap_bytes += g_variant_get_size (priv->icon[icon].pixmap);
+
+    /* only keep the encoded data & wire form; it'll be decoded again if
+     * needed (e.g. pixmap sizes change) */
+    if (priv->icon[icon].data)
+    {
+        g_object_unref (priv->icon[icon].pixbuf);
+        priv->icon[icon].pixbuf = NULL;
+    }
+
+    return priv->icon[icon].pixmap;
+}
+
+static void
+dbus_failed (StatusNotifierItem *sn, GError *error, gboolean fatal)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    guint id = 0;
+
+    /* unless fatal keep watching the watcher, so if it shows up (again) we'll
+     * resume the registering automatically */
+    if (!fatal)
+    {
+        id = priv->dbus_watch_id;
+        /* (so dbus_free() doesn't unwatch) */
+        priv->dbus_watch_id = 0;
+    }
+    dbus_free (sn);
+    priv->dbus_watch_id = id;
+    if (fatal)
+    {
+        priv->state = STATUS_NOTIFIER_STATE_FAILED;
+        notify (sn, PROP_STATE);
+    }
+    g_signal_emit (sn, status_notifier_item_signals[SIGNAL_REGISTRATION_FAILED], 0,
+            error);
+    g_error_free (error);
+}
+
+/* like dbus_failed() but when @sn is still on the bus, only needing to register
+ * with the watcher (again) */
+static void
+dbus_unregistered (StatusNotifierItem *sn, GError *error)
 {
-    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    g_free (priv->tooltip_title);
-    priv->tooltip_title = g_strdup (title);
+    if (priv->state == STATUS_NOTIFIER_STATE_REGISTERED)
+    {
+        priv->state = STATUS_NOTIFIER_STATE_REGISTERING;
+        notify (sn, PROP_STATE);
+    }
+    g_signal_emit (sn, status_notifier_item_signals[SIGNAL_REGISTRATION_FAILED], 0,
+            error);
+    g_error_free (error);
+}
 
-    notify (sn, PROP_TOOLTIP_TITLE);
-    if (priv->tooltip_freeze == 0)
-        dbus_notify (sn, PROP_TOOLTIP_TITLE);
+/* introspection data is parsed once, when first needed, and then shared by all
+ * items for the lifetime of the process */
+static GDBusInterfaceInfo *
+get_interface_info (guint interface)
+{
+    static GDBusInterfaceInfo *infos[NB_INTERFACES];
+    static const gchar * const xmls[NB_INTERFACES] = {
+        item_xml,
+        watcher_xml,
+        debug_xml,
+        menu_xml
+    };
+
+    if (g_once_init_enter (&infos[interface]))
+    {
+        GDBusNodeInfo *node;
+        GDBusInterfaceInfo *info;
+
+        node = g_dbus_node_info_new_for_xml (xmls[interface], NULL);
+        info = g_dbus_interface_info_ref (node->interfaces[0]);
+        g_dbus_node_info_unref (node);
+        /* speeds up lookups GDBus does on each call */
+        g_dbus_interface_info_cache_build (info);
+
+        g_once_init_leave (&infos[interface], info);
+    }
+
+    return infos[interface];
 }
 
-/**
- * status_notifier_item_get_tooltip_title:
- * @sn: A #StatusNotifierItem
- *
- * Returns the tooltip title
- *
- * Returns: A newly allocated string of the tooltip title, use g_free() when
- * done
- */
-gchar *
-status_notifier_item_get_tooltip_title (StatusNotifierItem      *sn)
+GDBusInterfaceInfo *
+_status_notifier_get_watcher_interface_info (void)
 {
-    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+    return get_interface_info (INTERFACE_WATCHER);
+}
 
-    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-    return g_strdup (priv->tooltip_title);
+GDBusInterfaceInfo *
+_status_notifier_get_item_interface_info (void)
+{
+    return get_interface_info (INTERFACE_ITEM);
 }
 
-/**
- * status_notifier_item_set_tooltip_body:
- * @sn: A #StatusNotifierItem
- * @body: The tooltip body
- *
- * Sets the body of the tooltip
- *
- * This body can contain some markup, which consists of a small subset of XHTML.
- * See http://www.notmart.org/misc/statusnotifieritem/markup.html for more.
- *
- * The tooltip is composed of a title, a body, and an icon. Note that changing
- * any of these will trigger a DBus signal NewToolTip (for hosts to refresh DBus
- * property ToolTip), see status_notifier_item_freeze_tooltip() for changing more
- * than one and only emitting one DBus signal at the end.
- */
-void
-status_notifier_item_set_tooltip_body (StatusNotifierItem      *sn,
-                                       const gchar             *body)
+GDBusInterfaceInfo *
+_status_notifier_get_debug_interface_info (void)
+{
+    return get_interface_info (INTERFACE_DEBUG);
+}
+
+GDBusInterfaceInfo *
+_status_notifier_get_menu_interface_info (void)
+{
+    return get_interface_info (INTERFACE_MENU);
+}
+
+const GDBusInterfaceVTable *
+_status_notifier_item_get_debug_vtable (StatusNotifierItem     *sn)
 {
-    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return (priv->export_stats) ? &debug_vtable : NULL;
+}
 
-    g_free (priv->tooltip_body);
-    priv->tooltip_body = g_strdup (body);
+const GDBusInterfaceVTable *
+_status_notifier_item_get_interface_vtable (void)
+{
+    return &item_vtable;
+}
 
-    notify (sn, PROP_TOOLTIP_BODY);
-    if (priv->tooltip_freeze == 0)
-        dbus_notify (sn, PROP_TOOLTIP_BODY);
+static Service *
+service_ref (Service *service)
+{
+    g_atomic_int_inc (&service->ref_count);
+    return service;
 }
 
-/**
- * status_notifier_item_get_tooltip_body:
- * @sn: A #StatusNotifierItem
- *
- * Returns the tooltip body
- *
- * Returns: A newly allocated string of the tooltip body, use g_free() when done
- */
-gchar *
-status_notifier_item_get_tooltip_body (StatusNotifierItem      *sn)
+static void
+service_unref (Service *service)
 {
-    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+    guint i;
+
+    if (!g_atomic_int_dec_and_test (&service->ref_count))
+        return;
+
+    g_weak_ref_clear (&service->item);
+    g_main_loop_unref (service->loop);
+    g_main_context_unref (service->context);
+    g_main_context_unref (service->item_context);
+    g_mutex_clear (&service->lock);
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+        if (service->values[i])
+            g_variant_unref (service->values[i]);
+    if (service->snapshot)
+        g_variant_unref (service->snapshot);
+    g_slice_free (Service, service);
+}
 
+/* makes the current values of DBus properties those served by the service
+ * thread. Called from the item's context. */
+static void
+service_publish (StatusNotifierItem *sn)
+{
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-    return g_strdup (priv->tooltip_body);
+    Service *service = priv->service;
+    GVariant *old[NB_DBUS_PROPS + 1];
+    GVariant *snapshot;
+    guint i;
+
+    if (priv->service_publish_source)
+    {
+        g_source_destroy (priv->service_publish_source);
+        priv->service_publish_source = NULL;
+    }
+    if (!service)
+        return;
+
+    /* (only ever changed from here, so no need to lock to read it) */
+    snapshot = get_dbus_snapshot (sn);
+    if (service->snapshot == snapshot)
+        return;
+
+    g_mutex_lock (&service->lock);
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+    {
+        old[i] = service->values[i];
+        service->values[i] = g_variant_ref (priv->dbus_values[i]);
+    }
+    old[NB_DBUS_PROPS] = service->snapshot;
+    service->snapshot = g_variant_ref (snapshot);
+    g_mutex_unlock (&service->lock);
+
+    for (i = 0; i <= NB_DBUS_PROPS; ++i)
+        if (old[i])
+            g_variant_unref (old[i]);
+}
+
+static gboolean
+service_publish_cb (gpointer data)
+{
+    StatusNotifierItem *sn = data;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    priv->service_publish_source = NULL;
+    /* in the middle of an update, status_notifier_item_commit_update() will
+     * take care of it */
+    if (priv->update_freeze == 0)
+        service_publish (sn);
+    return G_SOURCE_REMOVE;
 }
 
+/* same as properties_call() but from the service thread, off the values
+ * published last */
 static void
-method_call (GDBusConnection        *conn _UNUSED_,
-             const gchar            *sender _UNUSED_,
-             const gchar            *object _UNUSED_,
-             const gchar            *interface _UNUSED_,
-             const gchar            *method,
-             GVariant               *params,
-             GDBusMethodInvocation  *invocation,
-             gpointer                data)
+service_properties_call (Service                *service,
+                         const gchar            *method,
+                         GVariant               *params,
+                         GDBusMethodInvocation  *invocation)
 {
-    StatusNotifierItem *sn = (StatusNotifierItem *) data;
-    guint signal;
-    gint x, y;
-    gboolean ret;
+    GVariant *value;
 
-    if (!g_strcmp0 (method, "ContextMenu"))
-        signal = SIGNAL_CONTEXT_MENU;
-    else if (!g_strcmp0 (method, "Activate"))
-        signal = SIGNAL_ACTIVATE;
-    else if (!g_strcmp0 (method, "SecondaryActivate"))
-        signal = SIGNAL_SECONDARY_ACTIVATE;
-    else if (!g_strcmp0 (method, "Scroll"))
+    if (!g_strcmp0 (method, "GetAll"))
     {
-        gint delta, orientation;
-        gchar *s_orientation;
+        g_atomic_int_inc (&service->stats_get_all);
+        g_mutex_lock (&service->lock);
+        value = g_variant_ref (service->snapshot);
+        g_mutex_unlock (&service->lock);
+
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(@a{sv})", value));
+        g_variant_unref (value);
+    }
+    else if (!g_strcmp0 (method, "Get"))
+    {
+        const gchar *property;
+        guint prop;
+
+        g_variant_get (params, "(&s&s)", NULL, &property);
+        prop = GPOINTER_TO_UINT (g_hash_table_lookup (get_dispatch_table (FALSE),
+                    property));
+        /* should never happen, GDBus checks against the introspection data */
+        if (G_UNLIKELY (prop == 0))
+        {
+            g_dbus_method_invocation_return_error (invocation,
+                    G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+                    "No such property: %s", property);
+            return;
+        }
 
-        g_variant_get (params, "(is)", &delta, &s_orientation);
-        if (!g_ascii_strcasecmp (s_orientation, "vertical"))
-            orientation = STATUS_NOTIFIER_SCROLL_ORIENTATION_VERTICAL;
-        else
-            orientation = STATUS_NOTIFIER_SCROLL_ORIENTATION_HORIZONTAL;
-        g_free (s_orientation);
+        g_atomic_int_inc (&service->stats_get[prop - 1]);
+        g_mutex_lock (&service->lock);
+        value = g_variant_ref (service->values[prop - 1]);
+        g_mutex_unlock (&service->lock);
 
-        g_signal_emit (sn, status_notifier_item_signals[SIGNAL_SCROLL], 0,
-                delta, orientation, &ret);
-        g_dbus_method_invocation_return_value (invocation, NULL);
-        return;
+        g_dbus_method_invocation_return_value (invocation,
+                g_variant_new ("(v)", value));
+        g_variant_unref (value);
     }
     else
-        /* should never happen */
-        g_return_if_reached ();
+        g_dbus_method_invocation_return_error (invocation,
+                G_DBUS_ERROR, G_DBUS_ERROR_PROPERTY_READ_ONLY,
+                "Properties are read-only");
+}
 
-    g_variant_get (params, "(ii)", &x, &y);
-    g_signal_emit (sn, status_notifier_item_signals[signal], 0, x, y, &ret);
-    g_dbus_method_invocation_return_value (invocation, NULL);
+typedef struct
+{
+    Service *service;
+    GDBusMethodInvocation *invocation;
+} ServiceCall;
+
+static void
+service_call_free (gpointer data)
+{
+    ServiceCall *call = data;
+
+    /* not run, e.g. the context was destroyed */
+    if (call->invocation)
+        g_object_unref (call->invocation);
+    service_unref (call->service);
+    g_slice_free (ServiceCall, call);
 }
 
-static GVariantBuilder *
-get_builder_for_icon_pixmap (StatusNotifierItem *sn, StatusNotifierIcon icon)
+/* runs in the item's context a method call received in the service thread */
+static gboolean
+service_forward (gpointer data)
 {
-    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    ServiceCall *call = data;
+    GDBusMethodInvocation *invocation = call->invocation;
+    StatusNotifierItem *sn;
 
-    GVariantBuilder *builder;
-    cairo_surface_t *surface;
-    cairo_t *cr;
-    gint width, height, stride;
-    guint *data;
+    call->invocation = NULL;
+    sn = g_weak_ref_get (&call->service->item);
+    if (!sn)
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                "Item was removed");
+        return G_SOURCE_REMOVE;
+    }
 
-    if (G_UNLIKELY (!priv->icon[icon].has_pixbuf))
-        return NULL;
+    method_call (g_dbus_method_invocation_get_connection (invocation),
+            g_dbus_method_invocation_get_sender (invocation),
+            g_dbus_method_invocation_get_object_path (invocation),
+            g_dbus_method_invocation_get_interface_name (invocation),
+            g_dbus_method_invocation_get_method_name (invocation),
+            g_dbus_method_invocation_get_parameters (invocation),
+            invocation,
+            sn);
+    g_object_unref (sn);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+service_method_call (GDBusConnection        *conn _UNUSED_,
+                     const gchar            *sender _UNUSED_,
+                     const gchar            *object _UNUSED_,
+                     const gchar            *interface,
+                     const gchar            *method,
+                     GVariant               *params,
+                     GDBusMethodInvocation  *invocation,
+                     gpointer                data)
+{
+    Service *service = data;
+    ServiceCall *call;
 
-    width = gdk_pixbuf_get_width (priv->icon[icon].pixbuf);
-    height = gdk_pixbuf_get_height (priv->icon[icon].pixbuf);
+    if (!g_strcmp0 (interface, "org.freedesktop.DBus.Properties"))
+    {
+        service_properties_call (service, method, params, invocation);
+        return;
+    }
 
-    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
-    cr = cairo_create (surface);
-    gdk_cairo_set_source_pixbuf (cr, priv->icon[icon].pixbuf, 0, 0);
-    cairo_paint (cr);
-    cairo_destroy (cr);
+    /* signals are emitted from the item's context */
+    call = g_slice_new (ServiceCall);
+    call->service = service_ref (service);
+    call->invocation = invocation;
+    g_main_context_invoke_full (service->item_context, G_PRIORITY_DEFAULT,
+            service_forward, call, service_call_free);
+}
 
-    stride = cairo_image_surface_get_stride (surface);
-    cairo_surface_flush (surface);
-    data = (guint *) cairo_image_surface_get_data (surface);
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-    guint i, max;
+static const GDBusInterfaceVTable service_vtable = {
+    .method_call = service_method_call,
+    .get_property = NULL, /* see service_properties_call() */
+    .set_property = NULL
+};
 
-    max = (guint) (stride * height) / sizeof (guint);
-    for (i = 0; i < max; ++i)
-        data[i] = GUINT_TO_BE (data[i]);
-#endif
+static gpointer
+service_run (gpointer data)
+{
+    Service *service = data;
 
-    builder = g_variant_builder_new (G_VARIANT_TYPE ("a(iiay)"));
-    g_variant_builder_open (builder, G_VARIANT_TYPE ("(iiay)"));
-    g_variant_builder_add (builder, "i", width);
-    g_variant_builder_add (builder, "i", height);
-    g_variant_builder_add_value (builder,
-            g_variant_new_from_data (G_VARIANT_TYPE ("ay"),
-                data,
-                (gsize) (stride * height),
-                TRUE,
-                (GDestroyNotify) cairo_surface_destroy,
-                surface));
-    g_variant_builder_close (builder);
-    return builder;
+    g_main_context_push_thread_default (service->context);
+    g_main_loop_run (service->loop);
+    g_main_context_pop_thread_default (service->context);
+    return NULL;
 }
 
-static GVariant *
-get_prop (GDBusConnection        *conn _UNUSED_,
-          const gchar            *sender _UNUSED_,
-          const gchar            *object _UNUSED_,
-          const gchar            *interface _UNUSED_,
-          const gchar            *property,
-          GError                **error _UNUSED_,
-          gpointer                data)
+static gboolean
+service_quit (gpointer data)
+{
+    g_main_loop_quit (((Service *) data)->loop);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+service_stop (StatusNotifierItem *sn)
 {
-    StatusNotifierItem *sn = (StatusNotifierItem *) data;
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Service *service = priv->service;
+    guint i;
+
+    if (!service)
+        return;
 
-    if (!g_strcmp0 (property, "Id"))
-        return g_variant_new ("s", priv->id);
-    else if (!g_strcmp0 (property, "Category"))
+    if (priv->service_publish_source)
     {
-        const gchar *const s_category[] = {
-            "ApplicationStatus",
-            "Communications",
-            "SystemServices",
-            "Hardware"
-        };
-        return g_variant_new ("s", s_category[priv->category]);
+        g_source_destroy (priv->service_publish_source);
+        priv->service_publish_source = NULL;
     }
-    else if (!g_strcmp0 (property, "Title"))
-        return g_variant_new ("s", (priv->title) ? priv->title : "");
-    else if (!g_strcmp0 (property, "Status"))
+    priv->service = NULL;
+
+    /* (not g_main_loop_quit() directly, in case it isn't running yet) */
+    if (service->thread)
     {
-        const gchar *const s_status[] = {
-            "Passive",
-            "Active",
-            "NeedsAttention"
-        };
-        return g_variant_new ("s", s_status[priv->status]);
-    }
-    else if (!g_strcmp0 (property, "WindowId"))
-        return g_variant_new ("i", priv->window_id);
-    else if (!g_strcmp0 (property, "IconName"))
-        return g_variant_new ("s", (!priv->icon[STATUS_NOTIFIER_ICON].has_pixbuf)
-                ? ((priv->icon[STATUS_NOTIFIER_ICON].icon_name)
-                    ? priv->icon[STATUS_NOTIFIER_ICON].icon_name : "") : "");
-    else if (!g_strcmp0 (property, "IconPixmap"))
-        return g_variant_new ("a(iiay)",
-                get_builder_for_icon_pixmap (sn, STATUS_NOTIFIER_ICON));
-    else if (!g_strcmp0 (property, "OverlayIconName"))
-        return g_variant_new ("s", (!priv->icon[STATUS_NOTIFIER_OVERLAY_ICON].has_pixbuf)
-                ? ((priv->icon[STATUS_NOTIFIER_OVERLAY_ICON].icon_name)
-                    ? priv->icon[STATUS_NOTIFIER_OVERLAY_ICON].icon_name : "") : "");
-    else if (!g_strcmp0 (property, "OverlayIconPixmap"))
-        return g_variant_new ("a(iiay)",
-                get_builder_for_icon_pixmap (sn, STATUS_NOTIFIER_OVERLAY_ICON));
-    else if (!g_strcmp0 (property, "AttentionIconName"))
-        return g_variant_new ("s", (!priv->icon[STATUS_NOTIFIER_ATTENTION_ICON].has_pixbuf)
-                ? ((priv->icon[STATUS_NOTIFIER_ATTENTION_ICON].icon_name)
-                    ? priv->icon[STATUS_NOTIFIER_ATTENTION_ICON].icon_name : "") : "");
-    else if (!g_strcmp0 (property, "AttentionIconPixmap"))
-        return g_variant_new ("a(iiay)",
-                get_builder_for_icon_pixmap (sn, STATUS_NOTIFIER_ATTENTION_ICON));
-    else if (!g_strcmp0 (property, "AttentionMovieName"))
-        return g_variant_new ("s", (priv->attention_movie_name)
-                ? priv->attention_movie_name : "");
-    else if (!g_strcmp0 (property, "ToolTip"))
-    {
-        GVariant *variant;
-        GVariantBuilder *builder;
-
-        if (!priv->icon[STATUS_NOTIFIER_TOOLTIP_ICON].has_pixbuf)
-        {
-            variant = g_variant_new ("(sa(iiay)ss)",
-                    (priv->icon[STATUS_NOTIFIER_TOOLTIP_ICON].icon_name)
-                    ? priv->icon[STATUS_NOTIFIER_TOOLTIP_ICON].icon_name : "",
-                    NULL,
-                    (priv->tooltip_title) ? priv->tooltip_title : "",
-                    (priv->tooltip_body) ? priv->tooltip_body : "");
-            return variant;
-        }
+        g_main_context_invoke (service->context, service_quit, service);
+        g_thread_join (service->thread);
+    }
 
-        builder = get_builder_for_icon_pixmap (sn, STATUS_NOTIFIER_TOOLTIP_ICON);
-        variant = g_variant_new ("(sa(iiay)ss)",
-                "",
-                builder,
-                (priv->tooltip_title) ? priv->tooltip_title : "",
-                (priv->tooltip_body) ? priv->tooltip_body : "");
-        g_variant_builder_unref (builder);
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+        priv->stats_get[i] += service->stats_get[i];
+    priv->stats_get_all += service->stats_get_all;
+    service_unref (service);
+}
 
-        return variant;
-    }
-    else if (!g_strcmp0 (property, "ItemIsMenu"))
-        return g_variant_new ("b", priv->item_is_menu);
-    else if (!g_strcmp0 (property, "Menu"))
+/* exports the item on @conn with calls dispatched in a new thread, see
+ * StatusNotifierItem:service-thread. Returns the registration id, or 0 */
+static guint
+service_start (StatusNotifierItem *sn, GDBusConnection *conn, GError **error)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    Service *service;
+    guint id;
+
+    service = g_slice_new0 (Service);
+    service->ref_count = 1;
+    g_weak_ref_init (&service->item, sn);
+    service->item_context = g_main_context_ref (priv->context);
+    service->context = g_main_context_new ();
+    service->loop = g_main_loop_new (service->context, FALSE);
+    g_mutex_init (&service->lock);
+    priv->service = service;
+    service_publish (sn);
+
+    /* GDBus dispatches calls in the thread-default context at the time.
+     * Unregistered in dbus_free() before the service is stopped */
+    g_main_context_push_thread_default (service->context);
+    id = g_dbus_connection_register_object (conn,
+            ITEM_OBJECT,
+            get_interface_info (INTERFACE_ITEM),
+            &service_vtable,
+            service, NULL,
+            error);
+    g_main_context_pop_thread_default (service->context);
+    if (id == 0)
     {
-#if USE_DBUSMENU
-        if (priv->menu_service != NULL)
-        {
-            GValue strval = { 0 };
-            GVariant *var;
-
-            g_value_init (&strval, G_TYPE_STRING);
-            g_object_get_property (G_OBJECT (priv->menu_service),
-                    DBUSMENU_SERVER_PROP_DBUS_OBJECT, &strval);
-            var = g_variant_new ("o", g_value_get_string (&strval));
-            g_value_unset (&strval);
-            return var;
-        }
-        else
-#endif
-            return g_variant_new ("o", "/NO_DBUSMENU");
+        service_stop (sn);
+        return 0;
     }
 
-    g_return_val_if_reached (NULL);
+    service->thread = g_thread_new ("statusnotifier", service_run, service);
+    return id;
+}
+
+/* records that registration of @sn reached @timing */
+static inline void
+mark_timing (StatusNotifierItem *sn, guint timing)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    priv->timings[timing] = g_get_monotonic_time ();
+}
+
+/* time (in ms) between the call to status_notifier_item_register() and
+ * @timing being reached. (Steps aren't always sequential, e.g. with
+ * #StatusNotifierItem:fast-start the name is acquired concurrently with the
+ * watcher being found.) */
+static gdouble
+timing_since_register (StatusNotifierItem *sn, guint timing)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->timings[timing] == 0)
+        return 0.;
+    return (gdouble) (priv->timings[timing] - priv->timings[TIMING_REGISTER]) / 1000.;
 }
 
 static void
-dbus_failed (StatusNotifierItem *sn, GError *error, gboolean fatal)
+export_menu_model (StatusNotifierItem *sn)
 {
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GError *err = NULL;
+    gchar *path;
 
-    dbus_free (sn);
-    if (fatal)
+    /* same as with dbusmenu, see status_notifier_item_set_context_menu() */
+    if (priv->manager)
+        path = g_strdup_printf ("/MenuBar/%u",
+                (guint) g_atomic_int_add (&uniq_id, 1) + 1);
+    else
+        path = g_strdup ("/MenuBar");
+
+    /* not worth failing the registration over, there's still context-menu */
+    if (!sn_menu_export (priv->menu_model, priv->dbus_conn, path, &err))
     {
-        priv->state = STATUS_NOTIFIER_STATE_FAILED;
-        notify (sn, PROP_STATE);
+        g_warning ("Failed to export menu: %s", err->message);
+        g_clear_error (&err);
     }
-    g_signal_emit (sn, status_notifier_item_signals[SIGNAL_REGISTRATION_FAILED], 0,
-            error);
-    g_error_free (error);
+    g_free (path);
+    dbus_invalidate (sn, DBUS_PROP_MENU);
 }
 
 static void
@@ -1863,28 +5030,40 @@ bus_acquired (GDBusConnection *conn, const gchar *name _UNUSED_, gpointer data)
     StatusNotifierItem *sn = (StatusNotifierItem *) data;
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    GDBusInterfaceVTable interface_vtable = {
-        .method_call = method_call,
-        .get_property = get_prop,
-        .set_property = NULL
-    };
-    GDBusNodeInfo *info;
-
-    info = g_dbus_node_info_new_for_xml (item_xml, NULL);
-    priv->dbus_reg_id = g_dbus_connection_register_object (conn,
-            ITEM_OBJECT,
-            info->interfaces[0],
-            &interface_vtable,
-            sn, NULL,
-            &err);
-    g_dbus_node_info_unref (info);
+    if (priv->service_thread)
+        priv->dbus_reg_id = service_start (sn, conn, &err);
+    else
+        priv->dbus_reg_id = g_dbus_connection_register_object (conn,
+                ITEM_OBJECT,
+                get_interface_info (INTERFACE_ITEM),
+                &item_vtable,
+                sn, NULL,
+                &err);
     if (priv->dbus_reg_id == 0)
     {
         dbus_failed (sn, err, TRUE);
         return;
     }
+    if (priv->export_stats)
+    {
+        priv->dbus_debug_id = g_dbus_connection_register_object (conn,
+                ITEM_OBJECT,
+                get_interface_info (INTERFACE_DEBUG),
+                &debug_vtable,
+                sn, NULL,
+                &err);
+        /* not worth failing the registration over */
+        if (priv->dbus_debug_id == 0)
+        {
+            g_warning ("Failed to export statistics: %s", err->message);
+            g_clear_error (&err);
+        }
+    }
 
     priv->dbus_conn = g_object_ref (conn);
+    if (priv->menu_model)
+        export_menu_model (sn);
+    mark_timing (sn, TIMING_OBJECT_EXPORTED);
 }
 
 static void
@@ -1902,16 +5081,37 @@ register_item_cb (GObject *sce, GAsyncResult *result, gpointer data)
     }
     g_variant_unref (variant);
 
+    mark_timing (sn, TIMING_REGISTERED);
+    if (priv->timings[TIMING_WATCHER_LOST] > 0)
+        g_debug ("Item %s registered again %.1fms after the watcher came back",
+                priv->id,
+                (gdouble) (priv->timings[TIMING_REGISTERED]
+                    - priv->timings[TIMING_WATCHER_APPEARED]) / 1000.);
+    else
+        g_debug ("Item %s registered in %.1fms (watcher at %.1f, proxy %.1f, "
+                "host %.1f, export %.1f, name %.1f)",
+                priv->id,
+                timing_since_register (sn, TIMING_REGISTERED),
+                timing_since_register (sn, TIMING_WATCHER_APPEARED),
+                timing_since_register (sn, TIMING_WATCHER_READY),
+                timing_since_register (sn, TIMING_REGISTERING),
+                timing_since_register (sn, TIMING_OBJECT_EXPORTED),
+                timing_since_register (sn, TIMING_NAME_ACQUIRED));
+
     priv->state = STATUS_NOTIFIER_STATE_REGISTERED;
     notify (sn, PROP_STATE);
 }
 
 static void
-name_acquired (GDBusConnection *conn _UNUSED_, const gchar *name, gpointer data)
+register_to_watcher (StatusNotifierItem *sn, const gchar *name)
 {
-    StatusNotifierItem *sn = (StatusNotifierItem *) data;
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    if (name != priv->dbus_name)
+    {
+        g_free (priv->dbus_name);
+        priv->dbus_name = g_strdup (name);
+    }
     g_dbus_proxy_call (priv->dbus_proxy,
             "RegisterStatusNotifierItem",
             g_variant_new ("(s)", name),
@@ -1924,6 +5124,32 @@ name_acquired (GDBusConnection *conn _UNUSED_, const gchar *name, gpointer data)
     priv->dbus_proxy = NULL;
 }
 
+static void
+name_acquired (GDBusConnection *conn _UNUSED_, const gchar *name, gpointer data)
+{
+    StatusNotifierItem *sn = (StatusNotifierItem *) data;
+
+    mark_timing (sn, TIMING_NAME_ACQUIRED);
+    register_to_watcher (sn, name);
+}
+
+/* with fast_start, the name might be acquired before the watcher is ready */
+static void
+fast_name_acquired (GDBusConnection *conn _UNUSED_, const gchar *name, gpointer data)
+{
+    StatusNotifierItem *sn = (StatusNotifierItem *) data;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    mark_timing (sn, TIMING_NAME_ACQUIRED);
+    if (priv->fast_watcher_ready)
+    {
+        priv->fast_watcher_ready = FALSE;
+        register_to_watcher (sn, name);
+    }
+    else
+        priv->fast_name = g_strdup (name);
+}
+
 static void
 name_lost (GDBusConnection *conn, const gchar *name _UNUSED_, gpointer data)
 {
@@ -1957,10 +5183,77 @@ should_register_name (StatusNotifierItem *sn)
 }
 
 static void
-dbus_reg_item (StatusNotifierItem *sn)
+own_name (StatusNotifierItem *sn, GBusNameAcquiredCallback acquired_cb)
 {
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
     gchar buf[64], *b = buf;
+    guint id = (guint) g_atomic_int_add (&uniq_id, 1) + 1;
+
+    if (G_UNLIKELY (g_snprintf (buf, 64, "org.kde.StatusNotifierItem-%u-%u",
+                    getpid (), id) >= 64))
+        b = g_strdup_printf ("org.kde.StatusNotifierItem-%u-%u",
+            getpid (), id);
+    if (priv->manager)
+    {
+        /* use the connection shared by the manager */
+        bus_acquired (g_dbus_proxy_get_connection (priv->dbus_proxy), NULL, sn);
+        if (priv->dbus_conn)
+            priv->dbus_owner_id = g_bus_own_name_on_connection (priv->dbus_conn,
+                    b,
+                    G_BUS_NAME_OWNER_FLAGS_NONE,
+                    acquired_cb,
+                    name_lost,
+                    sn, NULL);
+    }
+    else
+        priv->dbus_owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
+                b,
+                G_BUS_NAME_OWNER_FLAGS_NONE,
+                bus_acquired,
+                acquired_cb,
+                name_lost,
+                sn, NULL);
+    if (G_UNLIKELY (b != buf))
+        g_free (b);
+}
+
+static void
+dbus_reg_item (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    mark_timing (sn, TIMING_REGISTERING);
+    if (priv->dbus_name)
+    {
+        /* still on the bus from before the watcher went away */
+        register_to_watcher (sn, priv->dbus_name);
+        return;
+    }
+
+    if (priv->manager && _status_notifier_manager_get_export_subtree (priv->manager))
+    {
+        GDBusConnection *conn = g_dbus_proxy_get_connection (priv->dbus_proxy);
+        GError *err = NULL;
+
+        /* No name to own, simply export the item and register it using its
+         * object path. (The specification mentions using "name/path" but
+         * KDE's watcher treats anything not starting with a slash as a name
+         * only, while using the path makes them use the sender's unique name
+         * with it.) */
+        priv->object_path = _status_notifier_manager_export_item (priv->manager,
+                sn, conn, &err);
+        if (!priv->object_path)
+        {
+            dbus_failed (sn, err, TRUE);
+            return;
+        }
+        priv->dbus_conn = g_object_ref (conn);
+        if (priv->menu_model)
+            export_menu_model (sn);
+        mark_timing (sn, TIMING_OBJECT_EXPORTED);
+        name_acquired (NULL, priv->object_path, sn);
+        return;
+    }
 
     if (!should_register_name (sn))
     {
@@ -1970,19 +5263,44 @@ dbus_reg_item (StatusNotifierItem *sn)
         return;
     }
 
-    if (G_UNLIKELY (g_snprintf (buf, 64, "org.kde.StatusNotifierItem-%u-%u",
-                    getpid (), ++uniq_id) >= 64))
-        b = g_strdup_printf ("org.kde.StatusNotifierItem-%u-%u",
-            getpid (), uniq_id);
-    priv->dbus_owner_id = g_bus_own_name (G_BUS_TYPE_SESSION,
-            b,
-            G_BUS_NAME_OWNER_FLAGS_NONE,
-            bus_acquired,
-            name_acquired,
-            name_lost,
-            sn, NULL);
-    if (G_UNLIKELY (b != buf))
-        g_free (b);
+    own_name (sn, name_acquired);
+}
+
+/* with fast start, whether the name was acquired, or is being acquired, ahead
+ * of registering with the watcher; it's then kept (and the item exported) while
+ * waiting for a watcher/host */
+static gboolean
+fast_pending (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    return priv->fast_owning && !priv->dbus_name;
+}
+
+/* with fast start, registers with the watcher using the name acquired early
+ * (or once acquired); returns FALSE if not in fast start */
+static gboolean
+fast_register (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (priv->fast_name)
+    {
+        /* name was already acquired */
+        gchar *name = priv->fast_name;
+
+        priv->fast_name = NULL;
+        register_to_watcher (sn, name);
+        g_free (name);
+        return TRUE;
+    }
+    else if (fast_pending (sn))
+    {
+        /* name is being acquired */
+        priv->fast_watcher_ready = TRUE;
+        return TRUE;
+    }
+    return FALSE;
 }
 
 static void
@@ -1999,8 +5317,70 @@ watcher_signal (GDBusProxy          *proxy _UNUSED_,
         g_signal_handler_disconnect (priv->dbus_proxy, priv->dbus_sid);
         priv->dbus_sid = 0;
 
+        if (!fast_register (sn))
+            dbus_reg_item (sn);
+    }
+}
+
+/* we have a proxy for the watcher, register unless we need to wait for a host
+ * to register first */
+static void
+watcher_ready (StatusNotifierItem *sn, gboolean host_registered)
+{
+    GError *err = NULL;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    mark_timing (sn, TIMING_WATCHER_READY);
+    if (!host_registered)
+    {
+        GDBusProxy *proxy;
+
+        g_set_error (&err, STATUS_NOTIFIER_ERROR,
+                STATUS_NOTIFIER_ERROR_NO_HOST,
+                "No Host registered on the Watcher");
+
+        /* keep the proxy, we'll wait for the signal when a host registers */
+        proxy = priv->dbus_proxy;
+        /* (so dbus_free() from dbus_failed() doesn't unref) */
+        priv->dbus_proxy = NULL;
+        if (priv->dbus_name || fast_pending (sn))
+            dbus_unregistered (sn, err);
+        else
+            dbus_failed (sn, err, FALSE);
+        priv->dbus_proxy = proxy;
+
+        /* the manager will let us know */
+        if (!priv->manager)
+            priv->dbus_sid = g_signal_connect (priv->dbus_proxy, "g-signal",
+                    (GCallback) watcher_signal, sn);
+        return;
+    }
+
+    if (!fast_register (sn))
         dbus_reg_item (sn);
+}
+
+/* with fast_start, only the one property we need is loaded */
+static void
+host_registered_cb (GObject *sce, GAsyncResult *result, gpointer data)
+{
+    StatusNotifierItem *sn = (StatusNotifierItem *) data;
+    GVariant *variant, *value;
+    gboolean host_registered = FALSE;
+
+    /* on error, consider no host is registered, as when the property isn't
+     * cached in proxy_cb() */
+    variant = g_dbus_connection_call_finish ((GDBusConnection *) sce, result, NULL);
+    if (variant)
+    {
+        g_variant_get (variant, "(v)", &value);
+        if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            host_registered = g_variant_get_boolean (value);
+        g_variant_unref (value);
+        g_variant_unref (variant);
     }
+
+    watcher_ready (sn, host_registered);
 }
 
 static void
@@ -2011,6 +5391,7 @@ proxy_cb (GObject *sce _UNUSED_, GAsyncResult *result, gpointer data)
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
     GVariant *variant;
+    gboolean host_registered;
 
     priv->dbus_proxy = g_dbus_proxy_new_for_bus_finish (result, &err);
     if (!priv->dbus_proxy)
@@ -2019,30 +5400,133 @@ proxy_cb (GObject *sce _UNUSED_, GAsyncResult *result, gpointer data)
         return;
     }
 
+    if (priv->fast_start)
+    {
+        g_dbus_connection_call (g_dbus_proxy_get_connection (priv->dbus_proxy),
+                WATCHER_NAME,
+                WATCHER_OBJECT,
+                "org.freedesktop.DBus.Properties",
+                "Get",
+                g_variant_new ("(ss)", WATCHER_INTERFACE,
+                    "IsStatusNotifierHostRegistered"),
+                G_VARIANT_TYPE ("(v)"),
+                G_DBUS_CALL_FLAGS_NONE,
+                -1,
+                NULL,
+                host_registered_cb,
+                sn);
+        return;
+    }
+
     variant = g_dbus_proxy_get_cached_property (priv->dbus_proxy,
             "IsStatusNotifierHostRegistered");
-    if (!variant || !g_variant_get_boolean (variant))
-    {
-        GDBusProxy *proxy;
+    host_registered = variant && g_variant_get_boolean (variant);
+    if (variant)
+        g_variant_unref (variant);
 
-        g_set_error (&err, STATUS_NOTIFIER_ERROR,
-                STATUS_NOTIFIER_ERROR_NO_HOST,
-                "No Host registered on the Watcher");
-        if (variant)
-            g_variant_unref (variant);
+    watcher_ready (sn, host_registered);
+}
 
-        /* keep the proxy, we'll wait for the signal when a host registers */
-        proxy = priv->dbus_proxy;
-        /* (so dbus_free() from dbus_failed() doesn't unref) */
-        priv->dbus_proxy = NULL;
-        dbus_failed (sn, err, FALSE);
-        priv->dbus_proxy = proxy;
+/* whether @sn is registering/registered, i.e. interested in the watcher */
+static gboolean
+is_registering (StatusNotifierItem *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    return priv->state == STATUS_NOTIFIER_STATE_REGISTERING
+        || priv->state == STATUS_NOTIFIER_STATE_REGISTERED;
+}
+
+/* the watcher went away; if @sn was on the bus (or getting there with fast
+ * start), keep it there and only register again once a watcher shows up, else
+ * start over */
+static void
+watcher_gone (StatusNotifierItem *sn)
+{
+    GError *err = NULL;
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    g_set_error (&err, STATUS_NOTIFIER_ERROR,
+            STATUS_NOTIFIER_ERROR_NO_WATCHER,
+            "No Watcher found");
 
-        priv->dbus_sid = g_signal_connect (priv->dbus_proxy, "g-signal",
-                (GCallback) watcher_signal, sn);
+    if (!priv->dbus_name && !fast_pending (sn))
+    {
+        dbus_failed (sn, err, FALSE);
         return;
     }
-    g_variant_unref (variant);
+
+    /* (no proxy to register with anymore) */
+    priv->fast_watcher_ready = FALSE;
+    if (priv->dbus_sid > 0)
+    {
+        g_signal_handler_disconnect (priv->dbus_proxy, priv->dbus_sid);
+        priv->dbus_sid = 0;
+    }
+    if (priv->dbus_proxy)
+    {
+        g_object_unref (priv->dbus_proxy);
+        priv->dbus_proxy = NULL;
+    }
+    if (priv->dbus_name)
+    {
+        mark_timing (sn, TIMING_WATCHER_LOST);
+        priv->timings[TIMING_WATCHER_APPEARED] = 0;
+        priv->timings[TIMING_WATCHER_READY] = 0;
+        priv->timings[TIMING_REGISTERING] = 0;
+        priv->timings[TIMING_REGISTERED] = 0;
+    }
+    dbus_unregistered (sn, err);
+}
+
+/* Items using a manager don't watch the watcher themselves, the manager lets
+ * them know via the following */
+
+void
+_status_notifier_item_watcher_appeared (StatusNotifierItem     *sn,
+                                        GDBusProxy             *proxy,
+                                        gboolean                host_registered)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    /* not registering, or already in progress */
+    if (!is_registering (sn) || priv->dbus_proxy
+            || (priv->dbus_conn && !priv->dbus_name))
+        return;
+
+    mark_timing (sn, TIMING_WATCHER_APPEARED);
+    priv->dbus_proxy = g_object_ref (proxy);
+    watcher_ready (sn, host_registered);
+}
+
+void
+_status_notifier_item_watcher_failed (StatusNotifierItem     *sn,
+                                      const GError           *error)
+{
+    if (!is_registering (sn))
+        return;
+
+    dbus_failed (sn, g_error_copy (error), TRUE);
+}
+
+void
+_status_notifier_item_watcher_vanished (StatusNotifierItem     *sn)
+{
+    if (!is_registering (sn))
+        return;
+
+    watcher_gone (sn);
+}
+
+void
+_status_notifier_item_host_registered (StatusNotifierItem     *sn)
+{
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    /* only if waiting for a host */
+    if (!is_registering (sn) || !priv->dbus_proxy
+            || (!priv->dbus_name && (priv->dbus_conn || priv->dbus_owner_id > 0)))
+        return;
 
     dbus_reg_item (sn);
 }
@@ -2056,22 +5540,18 @@ watcher_appeared (GDBusConnection   *conn _UNUSED_,
     StatusNotifierItem *sn = data;
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
-    GDBusNodeInfo *info;
-
-    g_bus_unwatch_name (priv->dbus_watch_id);
-    priv->dbus_watch_id = 0;
-
-    info = g_dbus_node_info_new_for_xml (watcher_xml, NULL);
+    /* we keep watching, to register again if the watcher is restarted */
+    mark_timing (sn, TIMING_WATCHER_APPEARED);
     g_dbus_proxy_new_for_bus (G_BUS_TYPE_SESSION,
-            G_DBUS_PROXY_FLAGS_NONE,
-            info->interfaces[0],
+            (priv->fast_start) ? G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES
+                : G_DBUS_PROXY_FLAGS_NONE,
+            get_interface_info (INTERFACE_WATCHER),
             WATCHER_NAME,
             WATCHER_OBJECT,
             WATCHER_INTERFACE,
             NULL,
             proxy_cb,
             sn);
-    g_dbus_node_info_unref (info);
 }
 
 static void
@@ -2079,24 +5559,7 @@ watcher_vanished (GDBusConnection   *conn _UNUSED_,
                   const gchar       *name _UNUSED_,
                   gpointer           data)
 {
-    GError *err = NULL;
-    StatusNotifierItem *sn = data;
-    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
-
-    guint id;
-
-    /* keep the watch active, so if a watcher shows up we'll resume the
-     * registering automatically */
-    id = priv->dbus_watch_id;
-    /* (so dbus_free() from dbus_failed() doesn't unwatch) */
-    priv->dbus_watch_id = 0;
-
-    g_set_error (&err, STATUS_NOTIFIER_ERROR,
-            STATUS_NOTIFIER_ERROR_NO_WATCHER,
-            "No Watcher found");
-    dbus_failed (sn, err, FALSE);
-
-    priv->dbus_watch_id = id;
+    watcher_gone ((StatusNotifierItem *) data);
 }
 
 /**
@@ -2136,6 +5599,14 @@ watcher_vanished (GDBusConnection   *conn _UNUSED_,
  * #StatusNotifierItem::registration-failed emitted on the same
  * #StatusNotifierItem.
  *
+ * This includes when the StatusNotifierWatcher goes away once @sn was
+ * registered, e.g. when the desktop shell is restarted: signal
+ * #StatusNotifierItem::registration-failed is emitted with
+ * %STATUS_NOTIFIER_ERROR_NO_WATCHER and #StatusNotifierItem:state goes back to
+ * %STATUS_NOTIFIER_STATE_REGISTERING. However @sn remains on the bus (keeping
+ * its name and object), and is simply registered again as soon as a watcher
+ * shows up.
+ *
  * Note that you can call status_notifier_item_register() after a fatal error
  * occured, to try again. You can also unref @sn while it is
  * %STATUS_NOTIFIER_STATE_REGISTERING safely.
@@ -2151,6 +5622,14 @@ status_notifier_item_register (StatusNotifierItem      *sn)
             || priv->state == STATUS_NOTIFIER_STATE_REGISTERED)
         return;
     priv->state = STATUS_NOTIFIER_STATE_REGISTERING;
+    memset (priv->timings, 0, sizeof (priv->timings));
+    mark_timing (sn, TIMING_REGISTER);
+
+    if (priv->manager)
+    {
+        _status_notifier_manager_register_item (priv->manager, sn);
+        return;
+    }
 
     priv->dbus_watch_id = g_bus_watch_name (G_BUS_TYPE_SESSION,
             WATCHER_NAME,
@@ -2158,6 +5637,14 @@ status_notifier_item_register (StatusNotifierItem      *sn)
             watcher_appeared,
             watcher_vanished,
             sn, NULL);
+
+    /* acquire the name while looking for the watcher */
+    if (priv->fast_start && should_register_name (sn))
+    {
+        mark_timing (sn, TIMING_REGISTERING);
+        priv->fast_owning = TRUE;
+        own_name (sn, fast_name_acquired);
+    }
 }
 
 /**
@@ -2178,6 +5665,175 @@ status_notifier_item_get_state (StatusNotifierItem      *sn)
     return priv->state;
 }
 
+/**
+ * status_notifier_item_get_stats:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns statistics about the DBus traffic of @sn, and the work done to serve
+ * it, since its creation. The dictionary contains:
+ *
+ * - "signals" (a{su}): DBus signals emitted, by name (e.g. "NewIcon")
+ * - "properties-changed" (u): PropertiesChanged signals emitted (see
+ *   #StatusNotifierItem:emit-properties-changed)
+ * - "get" (a{su}): Get calls, by property name
+ * - "get-all" (u): GetAll calls
+ * - "methods" (a{su}): method calls, by name (e.g. "Activate")
+ * - "value-cache-hits" (u), "value-cache-misses" (u): how many times the
+ *   value of a DBus property was available or had to be serialized
+ * - "pixmap-cache-hits" (u), "pixmap-cache-misses" (u): same for pixmaps, see
+ *   status_notifier_item_get_pixmap_cache_stats()
+ * - "pixmap-bytes" (t): total size of the pixmaps serialized
+ * - "raster-cache-hits" (u), "raster-cache-misses" (u): how many times an icon
+ *   set via #GIcon was available at a given size or had to be rendered
+ * - "raster-cache-bytes" (t): current size of the renders cached, including
+ *   those in use, see #StatusNotifierItem:raster-cache-size
+ *
+ * See also #StatusNotifierItem:export-stats
+ *
+ * Returns: (transfer full): A #GVariant of type a{sv} with the statistics of
+ * @sn. Unref it with g_variant_unref() when done.
+ *
+ * Since: 1.1.0
+ */
+GVariant *
+status_notifier_item_get_stats (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), NULL);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    GVariantBuilder builder;
+    GVariantBuilder counts;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+    g_variant_builder_init (&counts, G_VARIANT_TYPE ("a{su}"));
+    for (i = 0; i < NB_DBUS_SIGNALS; ++i)
+        g_variant_builder_add (&counts, "{su}",
+                dbus_signal_names[i], priv->stats_signals[i]);
+    g_variant_builder_add (&builder, "{sv}", "signals",
+            g_variant_builder_end (&counts));
+    g_variant_builder_add (&builder, "{sv}", "properties-changed",
+            g_variant_new_uint32 (priv->stats_properties_changed));
+
+    g_variant_builder_init (&counts, G_VARIANT_TYPE ("a{su}"));
+    for (i = 0; i < NB_DBUS_PROPS; ++i)
+        g_variant_builder_add (&counts, "{su}",
+                dbus_props[i].name, priv->stats_get[i] + ((priv->service)
+                    ? (guint) g_atomic_int_get (&priv->service->stats_get[i]) : 0));
+    g_variant_builder_add (&builder, "{sv}", "get",
+            g_variant_builder_end (&counts));
+    g_variant_builder_add (&builder, "{sv}", "get-all",
+            g_variant_new_uint32 (priv->stats_get_all + ((priv->service)
+                    ? (guint) g_atomic_int_get (&priv->service->stats_get_all) : 0)));
+
+    g_variant_builder_init (&counts, G_VARIANT_TYPE ("a{su}"));
+    for (i = 0; i < NB_DBUS_METHODS; ++i)
+        g_variant_builder_add (&counts, "{su}",
+                dbus_methods[i].name, priv->stats_methods[i]);
+    g_variant_builder_add (&builder, "{sv}", "methods",
+            g_variant_builder_end (&counts));
+
+    g_variant_builder_add (&builder, "{sv}", "value-cache-hits",
+            g_variant_new_uint32 (priv->value_cache_hits));
+    g_variant_builder_add (&builder, "{sv}", "value-cache-misses",
+            g_variant_new_uint32 (priv->value_cache_misses));
+    g_variant_builder_add (&builder, "{sv}", "pixmap-cache-hits",
+            g_variant_new_uint32 (priv->pixmap_cache_hits));
+    g_variant_builder_add (&builder, "{sv}", "pixmap-cache-misses",
+            g_variant_new_uint32 (priv->pixmap_cache_misses));
+    g_variant_builder_add (&builder, "{sv}", "pixmap-bytes",
+            g_variant_new_uint64 (priv->pixmap_bytes));
+    g_variant_builder_add (&builder, "{sv}", "raster-cache-hits",
+            g_variant_new_uint32 (priv->raster_cache_hits));
+    g_variant_builder_add (&builder, "{sv}", "raster-cache-misses",
+            g_variant_new_uint32 (priv->raster_cache_misses));
+    g_variant_builder_add (&builder, "{sv}", "raster-cache-bytes",
+            g_variant_new_uint64 (priv->raster_cache_bytes));
+
+    return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/**
+ * status_notifier_item_set_export_stats:
+ * @sn: A #StatusNotifierItem
+ * @export_stats: Whether to export statistics over DBus
+ *
+ * Sets whether statistics are exported over DBus. See
+ * #StatusNotifierItem:export-stats for more.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_set_export_stats (StatusNotifierItem      *sn,
+                                       gboolean                 export_stats)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    export_stats = !!export_stats;
+    if (priv->export_stats == export_stats)
+        return;
+
+    priv->export_stats = export_stats;
+    notify (sn, PROP_EXPORT_STATS);
+}
+
+/**
+ * status_notifier_item_get_export_stats:
+ * @sn: A #StatusNotifierItem
+ *
+ * Returns whether statistics are exported over DBus. See
+ * #StatusNotifierItem:export-stats for more.
+ *
+ * Returns: Whether statistics are exported over DBus
+ *
+ * Since: 1.1.0
+ */
+gboolean
+status_notifier_item_get_export_stats (StatusNotifierItem      *sn)
+{
+    g_return_val_if_fail (STATUS_NOTIFIER_IS_ITEM (sn), FALSE);
+
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+    return priv->export_stats;
+}
+
+/**
+ * status_notifier_item_get_registration_timings:
+ * @sn: A #StatusNotifierItem
+ * @timings: (out caller-allocates): Return location for the timings
+ *
+ * Fills @timings with when each step of the last registration of @sn (see
+ * status_notifier_item_register()) was reached, as given by
+ * g_get_monotonic_time(). Steps not (yet) reached are set to 0.
+ *
+ * Note that if registration is resumed, e.g. because no host was registered on
+ * the watcher, steps are updated as they're reached again. Also note that steps
+ * might not be reached in order, e.g. with #StatusNotifierItem:fast-start.
+ *
+ * When registration completes, the time spent in each step is also logged
+ * using g_debug(), i.e. it can be seen by setting G_MESSAGES_DEBUG.
+ *
+ * Since: 1.1.0
+ */
+void
+status_notifier_item_get_registration_timings (StatusNotifierItem      *sn,
+                                               StatusNotifierRegistrationTimings *timings)
+{
+    g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
+    g_return_if_fail (timings != NULL);
+    StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    timings->register_called  = priv->timings[TIMING_REGISTER];
+    timings->watcher_appeared = priv->timings[TIMING_WATCHER_APPEARED];
+    timings->watcher_ready    = priv->timings[TIMING_WATCHER_READY];
+    timings->registering      = priv->timings[TIMING_REGISTERING];
+    timings->object_exported  = priv->timings[TIMING_OBJECT_EXPORTED];
+    timings->name_acquired    = priv->timings[TIMING_NAME_ACQUIRED];
+    timings->registered       = priv->timings[TIMING_REGISTERED];
+    timings->watcher_lost     = priv->timings[TIMING_WATCHER_LOST];
+}
+
 /**
  * status_notifier_item_set_item_is_menu:
  * @sn: A #StatusNotifierItem
@@ -2200,7 +5856,18 @@ status_notifier_item_set_item_is_menu (StatusNotifierItem      *sn,
     g_return_if_fail (STATUS_NOTIFIER_IS_ITEM (sn));
 
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
+
+    if (!is_owner (priv))
+    {
+        queue_update (sn, UPDATE_ITEM_IS_MENU, 0, is_menu, NULL, NULL, NULL, NULL);
+        return;
+    }
+    is_menu = !!is_menu;
+    if (priv->item_is_menu == is_menu)
+        return;
+
     priv->item_is_menu = is_menu;
+    dbus_invalidate (sn, DBUS_PROP_ITEM_IS_MENU);
 }
 
 /**
@@ -2235,6 +5902,12 @@ status_notifier_item_get_item_is_menu (StatusNotifierItem      *sn)
  * If @menu is %NULL any current menu will be unset (and
  * #StatusNotifierItem::context_menu signals will be emitted as needed again).
  *
+ * Changes made to the menu once set (items added, removed or changed) are
+ * reflected over DBus as they happen, only for what changed. So to update the
+ * menu, rather than creating a new one and setting it, simply change it:
+ * setting a new menu means parsing it whole, and hosts fetching its whole
+ * layout again. Setting the same menu again does nothing.
+ *
  * Note that is dbusmenu support wasn't enabled during compilation, this
  * function does nothing but returning %FALSE, thus allowing you to fallback on
  * handling the #StatusNotifierItem::context_menu signal.
@@ -2254,10 +5927,17 @@ status_notifier_item_set_context_menu (StatusNotifierItem      *sn,
 
     StatusNotifierItemPrivate *priv = STATUS_NOTIFIER_ITEM_GET_PRIVATE(sn);
 
+    /* the parser already keeps the exported items in sync with it */
+    if (priv->menu == menu)
+        return TRUE;
+    if (menu && priv->menu_model)
+        status_notifier_item_set_menu_model (sn, NULL, NULL);
+
     if (priv->menu)
         g_object_unref (priv->menu);
 
     priv->menu = menu;
+    dbus_invalidate (sn, DBUS_PROP_MENU);
 
     if (menu)
     {
@@ -2267,7 +5947,21 @@ status_notifier_item_set_context_menu (StatusNotifierItem      *sn,
                                         GTK_WIDGET (priv->menu));
 
         if (priv->menu_service == NULL)
-            priv->menu_service = dbusmenu_server_new ("/MenuBar");
+        {
+            /* items of a manager share a connection, they can't all use the
+             * same path */
+            if (priv->manager)
+            {
+                gchar *path;
+
+                path = g_strdup_printf ("/MenuBar/%u",
+                        (guint) g_atomic_int_add (&uniq_id, 1) + 1);
+                priv->menu_service = dbusmenu_server_new (path);
+                g_free (path);
+            }
+            else
+                priv->menu_service = dbusmenu_server_new ("/MenuBar");
+        }
 
         dbusmenu_server_set_root (priv->menu_service, root);
 
@@ -27,6 +27,7 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include "statusnotifier-manager.h"
 
 G_BEGIN_DECLS
 
@@ -178,6 +179,56 @@ typedef enum
     STATUS_NOTIFIER_SCROLL_ORIENTATION_VERTICAL
 } StatusNotifierScrollOrientation;
 
+/**
+ * StatusNotifierRegistrationTimings:
+ * @register_called: When status_notifier_item_register() was called
+ * @watcher_appeared: When the StatusNotifierWatcher was found on the bus
+ * @watcher_ready: When the proxy for the watcher was ready, i.e. its properties
+ * loaded
+ * @registering: When the item started registering on the bus, i.e. once a
+ * StatusNotifierHost was known to be registered on the watcher
+ * @object_exported: When the item object was exported on the bus
+ * @name_acquired: When the item's name on the bus was acquired, or the item
+ * otherwise ready to be registered to the watcher
+ * @registered: When the watcher replied to the registration of the item
+ * @watcher_lost: When the watcher last went away while the item was on the
+ * bus. The item is then registered again once a watcher shows up, and
+ * @watcher_appeared, @watcher_ready, @registering and @registered refer to
+ * that new registration
+ *
+ * When each step of registering a #StatusNotifierItem was reached, as returned
+ * by g_get_monotonic_time(), or 0 when not (yet) reached. See
+ * status_notifier_item_get_registration_timings()
+ *
+ * Since: 1.1.0
+ */
+typedef struct
+{
+    gint64 register_called;
+    gint64 watcher_appeared;
+    gint64 watcher_ready;
+    gint64 registering;
+    gint64 object_exported;
+    gint64 name_acquired;
+    gint64 registered;
+    gint64 watcher_lost;
+} StatusNotifierRegistrationTimings;
+
+/**
+ * StatusNotifierSubmenuProvider:
+ * @sn: The #StatusNotifierItem
+ * @submenu: The #GMenu to fill
+ * @user_data: Data given to status_notifier_item_set_submenu_provider()
+ *
+ * Called to fill @submenu when a host is about to show it. @submenu is empty
+ * when called. See status_notifier_item_set_submenu_provider()
+ *
+ * Since: 1.1.0
+ */
+typedef void (*StatusNotifierSubmenuProvider) (StatusNotifierItem  *sn,
+                                               GMenu               *submenu,
+                                               gpointer             user_data);
+
 struct _StatusNotifierItem
 {
     /*< private >*/
@@ -246,12 +297,36 @@ void                    status_notifier_item_set_from_icon_name (
                                             StatusNotifierItem      *sn,
                                             StatusNotifierIcon       icon,
                                             const gchar             *icon_name);
+void                    status_notifier_item_set_from_bytes (
+                                            StatusNotifierItem      *sn,
+                                            StatusNotifierIcon       icon,
+                                            GBytes                  *bytes);
+gboolean                status_notifier_item_set_from_file (
+                                            StatusNotifierItem      *sn,
+                                            StatusNotifierIcon       icon,
+                                            const gchar             *filename,
+                                            GError                 **error);
+void                    status_notifier_item_set_from_gicon (
+                                            StatusNotifierItem      *sn,
+                                            StatusNotifierIcon       icon,
+                                            GIcon                   *gicon);
 gboolean                status_notifier_item_has_pixbuf (
                                             StatusNotifierItem      *sn,
                                             StatusNotifierIcon       icon);
 GdkPixbuf *             status_notifier_item_get_pixbuf (
                                             StatusNotifierItem      *sn,
                                             StatusNotifierIcon       icon);
+void                    status_notifier_item_get_pixmap_cache_stats (
+                                            StatusNotifierItem      *sn,
+                                            guint                   *hits,
+                                            guint                   *misses);
+GVariant *              status_notifier_item_get_stats (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_export_stats (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 export_stats);
+gboolean                status_notifier_item_get_export_stats (
+                                            StatusNotifierItem      *sn);
 gchar *                 status_notifier_item_get_icon_name (
                                             StatusNotifierItem      *sn,
                                             StatusNotifierIcon       icon);
@@ -275,6 +350,42 @@ void                    status_notifier_item_set_window_id (
                                             guint32                  window_id);
 guint32                 status_notifier_item_get_window_id (
                                             StatusNotifierItem      *sn);
+void                    status_notifier_item_set_pixmap_sizes (
+                                            StatusNotifierItem      *sn,
+                                            const gint              *sizes,
+                                            guint                    n_sizes);
+gint *                  status_notifier_item_get_pixmap_sizes (
+                                            StatusNotifierItem      *sn,
+                                            guint                   *n_sizes);
+void                    status_notifier_item_set_raster_cache_size (
+                                            StatusNotifierItem      *sn,
+                                            guint                    size);
+guint                   status_notifier_item_get_raster_cache_size (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_coalesce_signals (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 coalesce);
+gboolean                status_notifier_item_get_coalesce_signals (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_compare_pixbufs (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 compare);
+gboolean                status_notifier_item_get_compare_pixbufs (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_emit_properties_changed (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 emit);
+gboolean                status_notifier_item_get_emit_properties_changed (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_properties_changed_max_size (
+                                            StatusNotifierItem      *sn,
+                                            guint                    max_size);
+guint                   status_notifier_item_get_properties_changed_max_size (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_begin_update (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_commit_update (
+                                            StatusNotifierItem      *sn);
 void                    status_notifier_item_freeze_tooltip (
                                             StatusNotifierItem      *sn);
 void                    status_notifier_item_thaw_tooltip (
@@ -303,6 +414,9 @@ void                    status_notifier_item_register (
                                             StatusNotifierItem      *sn);
 StatusNotifierState     status_notifier_item_get_state (
                                             StatusNotifierItem      *sn);
+void                    status_notifier_item_get_registration_timings (
+                                            StatusNotifierItem      *sn,
+                                            StatusNotifierRegistrationTimings *timings);
 void                    status_notifier_item_set_item_is_menu (
                                             StatusNotifierItem      *sn,
                                             gboolean                 is_menu);
@@ -313,8 +427,40 @@ gboolean                status_notifier_item_set_context_menu (
                                             GObject                 *menu);
 GObject *               status_notifier_item_get_context_menu (
                                             StatusNotifierItem      *sn);
+void                    status_notifier_item_set_menu_model (
+                                            StatusNotifierItem      *sn,
+                                            GMenuModel              *model,
+                                            GActionGroup            *actions);
+GMenuModel *            status_notifier_item_get_menu_model (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_submenu_provider (
+                                            StatusNotifierItem      *sn,
+                                            GMenu                   *submenu,
+                                            StatusNotifierSubmenuProvider provider,
+                                            gpointer                 user_data,
+                                            GDestroyNotify           destroy);
+void                    status_notifier_item_invalidate_submenu (
+                                            StatusNotifierItem      *sn,
+                                            GMenu                   *submenu);
 gint                    status_notifier_item_get_register_name_on_bus (
                                             StatusNotifierItem      *sn);
+StatusNotifierManager * status_notifier_item_get_manager (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_fast_start (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 fast_start);
+gboolean                status_notifier_item_get_fast_start (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_service_thread (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 service_thread);
+gboolean                status_notifier_item_get_service_thread (
+                                            StatusNotifierItem      *sn);
+void                    status_notifier_item_set_reply_first (
+                                            StatusNotifierItem      *sn,
+                                            gboolean                 reply_first);
+gboolean                status_notifier_item_get_reply_first (
+                                            StatusNotifierItem      *sn);
 G_END_DECLS
 
 #endif /* __STATUS_NOTIFIER_H__ */